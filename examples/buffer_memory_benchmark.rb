@@ -0,0 +1,44 @@
+$LOAD_PATH.unshift File.expand_path('../../lib', __FILE__)
+
+require 'rubygems'
+require 'cool.io'
+require 'socket'
+
+# Holds many idle connections, each with a small write still pending in its
+# write buffer (a heartbeat reply the peer hasn't read yet), and reports the
+# memory the buffers hold compared to giving each one a full sized node.
+#
+#   ruby examples/buffer_memory_benchmark.rb [connections] [bytes pending]
+
+limit = Process.getrlimit(Process::RLIMIT_NOFILE).first
+CONNECTIONS = [(ARGV[0] || 5000).to_i, (limit - 64) / 2].min
+PENDING = (ARGV[1] || 40).to_i
+
+def rss
+  File.read("/proc/self/statm").split[1].to_i * 4096 rescue 0
+end
+
+event_loop = Cool.io::Loop.new
+before = Cool.io::Buffer.pool_stats[:slab_bytes]
+rss_before = rss
+
+connections = CONNECTIONS.times.map do
+  ours, theirs = UNIXSocket.pair
+  connection = Cool.io::IO.new(ours).attach(event_loop)
+  connection.write "x" * PENDING
+  [connection, theirs]
+end
+
+stats = Cool.io::Buffer.pool_stats
+held = stats[:slab_bytes] - before
+full = CONNECTIONS * Cool.io::Buffer.default_node_size
+
+puts "%d connections with %d bytes pending each" % [CONNECTIONS, PENDING]
+puts "%-24s %10.1f MiB (%d bytes per connection)" % ["buffer slabs", held / 1048576.0, held / CONNECTIONS]
+puts "%-24s %10.1f MiB" % ["one full node each", full / 1048576.0]
+puts "%-24s %10.1f MiB" % ["process RSS growth", (rss - rss_before) / 1048576.0]
+
+connections.each do |connection, theirs|
+  connection.close
+  theirs.close
+end
@@ -0,0 +1,74 @@
+$LOAD_PATH.unshift File.expand_path('../../lib', __FILE__)
+
+require 'rubygems'
+require 'cool.io'
+require 'benchmark'
+
+# Microbenchmark for Coolio::Buffer#write_to, reporting the write system
+# calls made per flush (from /proc/self/io on Linux) and the throughput of
+# flushing buffers of various sizes to /dev/null and to a socket pair
+# drained by a child process.  Buffers are made of default sized nodes, so
+# a per-node write loop makes one write(2) per node while a gather write
+# makes one writev(2) per IOV_MAX nodes.
+#
+#   ruby examples/buffer_write_benchmark.rb [flushes]
+
+FLUSHES = (ARGV[0] || 2000).to_i
+NODE_SIZE = Coolio::Buffer.default_node_size
+CHUNK = "x" * NODE_SIZE
+
+def write_syscalls
+  File.read("/proc/self/io")[/^syscw: (\d+)/, 1].to_i
+rescue Errno::ENOENT
+  nil
+end
+
+def fill(buffer, bytes)
+  (bytes / NODE_SIZE).times { buffer << CHUNK }
+end
+
+def flush(buffer, io)
+  until buffer.empty?
+    buffer.write_to(io)
+    IO.select(nil, [io]) unless buffer.empty?
+  end
+end
+
+def run(label, io, bytes)
+  buffer = Coolio::Buffer.new
+  syscalls_before = write_syscalls
+
+  elapsed = Benchmark.realtime do
+    FLUSHES.times do
+      fill(buffer, bytes)
+      flush(buffer, io)
+    end
+  end
+
+  syscalls = write_syscalls && (write_syscalls - syscalls_before).to_f / FLUSHES
+  puts "%-12s %5d KiB  %8s syscalls/flush  %9.1f MiB/s" % [
+    label, bytes / 1024, syscalls ? "%.1f" % syscalls : "n/a",
+    bytes * FLUSHES / elapsed / (1024 * 1024)
+  ]
+end
+
+sizes = [16, 64, 256, 1024].map { |kib| kib * 1024 }
+
+File.open("/dev/null", "w") do |devnull|
+  sizes.each { |bytes| run("/dev/null", devnull, bytes) }
+end
+
+reader, writer = UNIXSocket.pair
+drain = fork do
+  writer.close
+  begin
+    loop { reader.readpartial(1 << 20) }
+  rescue EOFError
+  end
+end
+reader.close
+
+sizes.each { |bytes| run("socketpair", writer, bytes) }
+
+writer.close
+Process.wait(drain)
@@ -0,0 +1,92 @@
+$LOAD_PATH.unshift File.expand_path('../../lib', __FILE__)
+
+require 'rubygems'
+require 'cool.io'
+
+# Shows the tradeoff behind Coolio::Loop#io_collect_interval on the echo
+# server: waiting longer between polls lets each iteration of the loop
+# handle more events, at the cost of added latency per round trip.
+#
+#   ruby examples/collect_interval_benchmark.rb [connections] [round trips per connection]
+
+ADDR = '127.0.0.1'
+CONNECTIONS = (ARGV[0] || 32).to_i
+ROUND_TRIPS = (ARGV[1] || 1000).to_i
+INTERVALS = [0, 0.0001, 0.001, 0.005]
+MESSAGE = "bounce this back to me\n"
+
+class EchoServerConnection < Cool.io::TCPSocket
+  def on_connect
+    self.direct_write = true
+  end
+
+  def on_read(data)
+    write data
+  end
+end
+
+# Runs the echo server in a child process, which reports how many loop
+# iterations it took and how many events they handled once it's told to stop
+def run_server(interval)
+  server = ::TCPServer.new(ADDR, 0)
+  port = server.addr[1]
+  reader, writer = ::IO.pipe
+
+  pid = fork do
+    reader.close
+    event_loop = Cool.io::Loop.new(:io_collect_interval => interval)
+    Cool.io::TCPServer.new(server, nil, EchoServerConnection).attach(event_loop)
+
+    stopped = false
+    stop = Cool.io::SignalWatcher.new(:TERM)
+    stop.on_signal { stopped = true }
+    stop.attach(event_loop)
+
+    iterations = events = 0
+    until stopped
+      events += event_loop.run_once
+      iterations += 1
+    end
+
+    writer.puts "#{iterations} #{events}"
+    writer.close
+  end
+
+  server.close
+  writer.close
+  [pid, port, reader]
+end
+
+def run_clients(port)
+  threads = CONNECTIONS.times.map do
+    Thread.new do
+      sock = ::TCPSocket.new(ADDR, port)
+      sock.setsockopt(::Socket::IPPROTO_TCP, ::Socket::TCP_NODELAY, 1)
+      latencies = ROUND_TRIPS.times.map do
+        started = Process.clock_gettime(Process::CLOCK_MONOTONIC)
+        sock.write MESSAGE
+        sock.readpartial(MESSAGE.size)
+        Process.clock_gettime(Process::CLOCK_MONOTONIC) - started
+      end
+      sock.close
+      latencies
+    end
+  end
+  threads.flat_map(&:value).sort
+end
+
+puts "%-10s %12s %10s %12s %12s" % %w(interval iterations events/iter median(ms) p99(ms))
+
+INTERVALS.each do |interval|
+  pid, port, reader = run_server(interval)
+  latencies = run_clients(port)
+
+  Process.kill(:TERM, pid)
+  iterations, events = reader.read.split.map(&:to_i)
+  reader.close
+  Process.wait(pid)
+
+  median = latencies[latencies.size / 2] * 1000
+  p99 = latencies[(latencies.size * 0.99).floor] * 1000
+  puts "%-10s %12d %10.2f %12.3f %12.3f" % [interval, iterations, events.to_f / iterations, median, p99]
+end
@@ -0,0 +1,68 @@
+$LOAD_PATH.unshift File.expand_path('../../lib', __FILE__)
+
+require 'rubygems'
+require 'cool.io'
+require 'benchmark'
+
+# Request/response benchmark for the echo server, comparing buffered writes
+# (which wait a loop iteration for writability) against direct writes.
+#
+#   ruby examples/echo_benchmark.rb [connections] [round trips per connection]
+
+ADDR = '127.0.0.1'
+CONNECTIONS = (ARGV[0] || 16).to_i
+ROUND_TRIPS = (ARGV[1] || 5000).to_i
+MESSAGE = "bounce this back to me\n"
+
+class EchoServerConnection < Cool.io::TCPSocket
+  def on_read(data)
+    write data
+  end
+end
+
+class DirectEchoServerConnection < EchoServerConnection
+  def on_connect
+    self.direct_write = true
+  end
+end
+
+def run_server(klass)
+  server = ::TCPServer.new(ADDR, 0)
+  port = server.addr[1]
+
+  pid = fork do
+    event_loop = Cool.io::Loop.default
+    Cool.io::TCPServer.new(server, nil, klass).attach(event_loop)
+    event_loop.run
+  end
+
+  server.close
+  [pid, port]
+end
+
+def run_clients(port)
+  threads = CONNECTIONS.times.map do
+    Thread.new do
+      sock = ::TCPSocket.new(ADDR, port)
+      sock.setsockopt(::Socket::IPPROTO_TCP, ::Socket::TCP_NODELAY, 1)
+      ROUND_TRIPS.times do
+        sock.write MESSAGE
+        sock.readpartial(MESSAGE.size)
+      end
+      sock.close
+    end
+  end
+  threads.each(&:join)
+end
+
+{ "buffered writes" => EchoServerConnection,
+  "direct writes"   => DirectEchoServerConnection }.each do |label, klass|
+  pid, port = run_server(klass)
+
+  elapsed = Benchmark.realtime { run_clients(port) }
+  total = CONNECTIONS * ROUND_TRIPS
+  puts "%-16s %8d round trips in %6.3fs (%9.1f/s)" % [label, total, elapsed, total / elapsed]
+
+  Process.kill(:TERM, pid)
+  Process.wait(pid)
+end
@@ -0,0 +1,60 @@
+$LOAD_PATH.unshift File.expand_path('../../lib', __FILE__)
+
+require 'rubygems'
+require 'cool.io'
+require 'benchmark'
+require 'objspace'
+
+# Compares the cost of keeping idle timeouts for many connections with a
+# TimerWatcher per connection against a single Coolio::TimerWheel: arming
+# every timeout, then re-arming each one once per simulated burst of
+# activity, then cancelling them all.  The memory held by the timers is
+# reported once they're all armed.
+#
+#   ruby examples/timer_wheel_benchmark.rb [connections] [bursts]
+
+CONNECTIONS = (ARGV[0] || 200_000).to_i
+BURSTS = (ARGV[1] || 5).to_i
+TIMEOUT = 30
+
+loop = Coolio::Loop.new
+connections = Array.new(CONNECTIONS) { Object.new }
+
+Benchmark.bm(22) do |bm|
+  timers = nil
+
+  bm.report("TimerWatcher arm") do
+    timers = connections.map { Coolio::TimerWatcher.new(TIMEOUT).attach(loop) }
+  end
+
+  timer_memory = timers.sum { |timer| ObjectSpace.memsize_of(timer) }
+
+  bm.report("TimerWatcher re-arm") do
+    BURSTS.times { timers.each(&:reset) }
+  end
+
+  bm.report("TimerWatcher cancel") do
+    timers.each(&:detach)
+  end
+
+  timers = nil
+  wheel = Coolio::TimerWheel.new.attach(loop)
+
+  bm.report("TimerWheel arm") do
+    connections.each { |connection| wheel.add(connection, TIMEOUT) }
+  end
+
+  wheel_memory = ObjectSpace.memsize_of(wheel)
+
+  bm.report("TimerWheel re-arm") do
+    BURSTS.times { connections.each { |connection| wheel.add(connection, TIMEOUT) } }
+  end
+
+  bm.report("TimerWheel cancel") do
+    connections.each { |connection| wheel.remove(connection) }
+  end
+
+  puts
+  puts "%-22s %8.1f MiB in %d objects" % ["TimerWatcher memory", timer_memory / 1048576.0, CONNECTIONS]
+  puts "%-22s %8.1f MiB in 1 object" % ["TimerWheel memory", wheel_memory / 1048576.0]
+end
@@ -15,6 +15,21 @@
 #include <unistd.h>
 #endif
 #include <errno.h>
+#include <limits.h>
+#ifdef HAVE_SYS_UIO_H
+#include <sys/uio.h>
+#endif
+#ifdef HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#endif
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
 
 /* 1 GiB maximum buffer size */
 #define MAX_BUFFER_SIZE 0x40000000
@@ -26,23 +41,90 @@
 #define FPTR_TO_FD(fptr) fptr->fd
 #endif
 
+/* Maximum number of nodes gathered into a single writev() */
+#ifdef HAVE_SYS_UIO_H
+#if defined(IOV_MAX) && IOV_MAX < 1024
+#define MAX_WRITEV_NODES IOV_MAX
+#else
+#define MAX_WRITEV_NODES 1024
+#endif
+#endif
+
 /* Default number of bytes in each node's buffer.  Should be >= MTU */
 #define DEFAULT_NODE_SIZE 16384
+
+/* Smallest node handed out for small appends, nodes double from here up
+ * to the buffer's node size */
+#define MIN_NODE_SIZE 128
 static unsigned default_node_size = DEFAULT_NODE_SIZE;
 
+/* Bytes of node slabs carved out of the heap at once */
+#define SLAB_SIZE 262144
+
+/* Slabs are mapped in units of this when hugepages are requested */
+#if defined(HAVE_SYS_MMAN_H) && defined(MADV_HUGEPAGE)
+#define HUGEPAGE_SIZE 2097152
+#endif
+
+/* Default bytes of completely unused slabs kept around for reuse */
+#define DEFAULT_POOL_RETAIN (8 * 1048576)
+
 struct buffer {
     unsigned size, node_size;
     struct buffer_node *head, *tail;
-    struct buffer_node *pool_head, *pool_tail;
-
+    unsigned external;
 };
 
+/*
+ * External nodes don't hold bytes themselves, data holds a frozen String
+ * which the node pins until it's been consumed.  Their size is kept equal
+ * to their end so that nothing is ever appended into the String
+ */
 struct buffer_node {
-    unsigned start, end;
+    unsigned start, end, size;
+    unsigned external;
     struct buffer_node *next;
+    struct buffer_slab *slab;
     unsigned char   data[0];
 };
 
+/*
+ * Nodes are allocated from slabs shared by every buffer in the process.
+ * Each slab keeps its own free list.  Slabs with some nodes in use are kept
+ * on their pool's partial list and are drawn from first.  Once all of a
+ * slab's nodes are free it's either retained on the pool's empty list or
+ * handed back, depending on how much empty slab memory is already retained
+ */
+struct buffer_slab {
+    struct buffer_pool *pool;
+    struct buffer_slab *prev, *next;
+    struct buffer_node *free;
+    unsigned free_count, node_count;
+    size_t bytes;
+    int mapped;
+};
+
+/* Slabs for nodes of a single size */
+struct buffer_pool {
+    unsigned node_size;
+    size_t node_bytes;
+    struct buffer_slab *partial, *empty;
+    struct buffer_pool *next;
+};
+
+static struct buffer_pool *buffer_pools = 0;
+static size_t pool_retain = DEFAULT_POOL_RETAIN;
+static int pool_hugepages = 0;
+
+/* Counters reported by Coolio::Buffer.pool_stats */
+static struct {
+    size_t allocated, cached, peak;
+    size_t slabs, slab_bytes, empty_bytes;
+} pool_stats;
+
+#define NODE_DATA(node) \
+    ((node)->external ? (unsigned char *) RSTRING_PTR(*(VALUE *) (node)->data) : (node)->data)
+
 static VALUE    mCoolio = Qnil;
 static VALUE    cCoolio_Buffer = Qnil;
 
@@ -52,6 +134,12 @@ static void     Coolio_Buffer_free(void *);
 
 static VALUE    Coolio_Buffer_default_node_size(VALUE klass);
 static VALUE    Coolio_Buffer_set_default_node_size(VALUE klass, VALUE size);
+static VALUE    Coolio_Buffer_pool_stats(VALUE klass);
+static VALUE    Coolio_Buffer_pool_retain(VALUE klass);
+static VALUE    Coolio_Buffer_set_pool_retain(VALUE klass, VALUE bytes);
+static VALUE    Coolio_Buffer_pool_hugepages(VALUE klass);
+static VALUE    Coolio_Buffer_set_pool_hugepages(VALUE klass, VALUE enabled);
+static VALUE    Coolio_Buffer_trim_pool(VALUE klass);
 static VALUE    Coolio_Buffer_initialize(int argc, VALUE * argv, VALUE self);
 static VALUE    Coolio_Buffer_clear(VALUE self);
 static VALUE    Coolio_Buffer_size(VALUE self);
@@ -60,18 +148,30 @@ static VALUE    Coolio_Buffer_append(VALUE self, VALUE data);
 static VALUE    Coolio_Buffer_prepend(VALUE self, VALUE data);
 static VALUE    Coolio_Buffer_read(int argc, VALUE * argv, VALUE self);
 static VALUE    Coolio_Buffer_read_frame(VALUE self, VALUE data, VALUE mark);
+static VALUE    Coolio_Buffer_read_until(int argc, VALUE * argv, VALUE self);
+static VALUE    Coolio_Buffer_each_frame(int argc, VALUE * argv, VALUE self);
 static VALUE    Coolio_Buffer_to_str(VALUE self);
 static VALUE    Coolio_Buffer_read_from(VALUE self, VALUE io);
 static VALUE    Coolio_Buffer_write_to(VALUE self, VALUE io);
+static VALUE    Coolio_Buffer_transfer_to(int argc, VALUE * argv, VALUE self);
+static VALUE    Coolio_Buffer_append_buffer(VALUE self, VALUE other);
+static VALUE    Coolio_Buffer_split(VALUE self, VALUE length);
 
 static struct buffer *buffer_init(struct buffer *);
 static void     buffer_clear(struct buffer * buf);
 static void     buffer_free(struct buffer * buf);
-static void     buffer_free_pool(struct buffer * buf);
+static size_t   buffer_pool_trim(size_t retain);
+static unsigned buffer_node_size(struct buffer * buf, unsigned len);
+static struct buffer_node *buffer_node_new(struct buffer * buf, unsigned size);
+static void     buffer_node_free(struct buffer * buf, struct buffer_node * node);
 static void     buffer_prepend(struct buffer * buf, char *str, unsigned len);
 static void     buffer_append(struct buffer * buf, char *str, unsigned len);
+static void     buffer_append_external(struct buffer * buf, VALUE str, unsigned start, unsigned end);
+static unsigned buffer_transfer(struct buffer * src, struct buffer * dst, unsigned len);
 static void     buffer_read(struct buffer * buf, char *str, unsigned len);
 static int      buffer_read_frame(struct buffer * buf, VALUE str, char frame_mark);
+static long     buffer_find(struct buffer * buf, const unsigned char *delim, unsigned len);
+static void     buffer_discard(struct buffer * buf, unsigned len);
 static void     buffer_copy(struct buffer * buf, char *str, unsigned len);
 static int      buffer_read_from(struct buffer * buf, int fd);
 static int      buffer_write_to(struct buffer * buf, int fd);
@@ -79,7 +179,9 @@ static int      buffer_write_to(struct buffer * buf, int fd);
 /*
  * High-performance I/O buffer intended for use in non-blocking programs
  *
- * Data is stored in as a memory-pooled linked list of equally sized chunks.
+ * Data is stored in as a linked list of chunks, allocated from slabs shared
+ * by every buffer in the process.  Small writes go to small chunks, which
+ * grow geometrically up to the buffer's node size as more data is queued.
  * Routines are provided for high speed non-blocking reads and writes from
  * Ruby IO objects.
  */
@@ -94,6 +196,18 @@ Init_coolio_buffer()
                    Coolio_Buffer_default_node_size, 0);
     rb_define_singleton_method(cCoolio_Buffer, "default_node_size=",
                    Coolio_Buffer_set_default_node_size, 1);
+    rb_define_singleton_method(cCoolio_Buffer, "pool_stats",
+                   Coolio_Buffer_pool_stats, 0);
+    rb_define_singleton_method(cCoolio_Buffer, "pool_retain",
+                   Coolio_Buffer_pool_retain, 0);
+    rb_define_singleton_method(cCoolio_Buffer, "pool_retain=",
+                   Coolio_Buffer_set_pool_retain, 1);
+    rb_define_singleton_method(cCoolio_Buffer, "pool_hugepages",
+                   Coolio_Buffer_pool_hugepages, 0);
+    rb_define_singleton_method(cCoolio_Buffer, "pool_hugepages=",
+                   Coolio_Buffer_set_pool_hugepages, 1);
+    rb_define_singleton_method(cCoolio_Buffer, "trim_pool",
+                   Coolio_Buffer_trim_pool, 0);
 
     rb_define_method(cCoolio_Buffer, "initialize", Coolio_Buffer_initialize, -1);
     rb_define_method(cCoolio_Buffer, "clear", Coolio_Buffer_clear, 0);
@@ -105,9 +219,14 @@ Init_coolio_buffer()
     rb_define_method(cCoolio_Buffer, "prepend", Coolio_Buffer_prepend, 1);
     rb_define_method(cCoolio_Buffer, "read", Coolio_Buffer_read, -1);
     rb_define_method(cCoolio_Buffer, "read_frame", Coolio_Buffer_read_frame, 2);
+    rb_define_method(cCoolio_Buffer, "read_until", Coolio_Buffer_read_until, -1);
+    rb_define_method(cCoolio_Buffer, "each_frame", Coolio_Buffer_each_frame, -1);
     rb_define_method(cCoolio_Buffer, "to_str", Coolio_Buffer_to_str, 0);
     rb_define_method(cCoolio_Buffer, "read_from", Coolio_Buffer_read_from, 1);
     rb_define_method(cCoolio_Buffer, "write_to", Coolio_Buffer_write_to, 1);
+    rb_define_method(cCoolio_Buffer, "transfer_to", Coolio_Buffer_transfer_to, -1);
+    rb_define_method(cCoolio_Buffer, "append_buffer", Coolio_Buffer_append_buffer, 1);
+    rb_define_method(cCoolio_Buffer, "split", Coolio_Buffer_split, 1);
 
     rb_define_const(cCoolio_Buffer, "MAX_SIZE", INT2NUM(MAX_BUFFER_SIZE));
 }
@@ -131,10 +250,18 @@ Coolio_Buffer_allocate(VALUE klass)
 }
 
 static void
-Coolio_Buffer_mark(void *buf)
+Coolio_Buffer_mark(void *data)
 {
-    /* Naively discard the memory pool whenever Ruby garbage collects */
-    buffer_free_pool(buf);
+    struct buffer *buf = data;
+    struct buffer_node *node;
+
+    if (!buf->external)
+        return;
+
+    /* Pin the Strings of external nodes, writes point straight into them */
+    for (node = buf->head; node; node = node->next)
+        if (node->external)
+            rb_gc_mark(*(VALUE *) node->data);
 }
 
 static void
@@ -185,11 +312,115 @@ Coolio_Buffer_set_default_node_size(VALUE klass, VALUE size)
     return size;
 }
 
+/**
+ * call-seq:
+ *   Coolio::Buffer.pool_stats -> Hash
+ *
+ * Statistics about the node slabs shared by all buffers:
+ *
+ * :allocated - nodes currently holding data for some buffer
+ * :cached - free nodes kept in slabs for reuse
+ * :peak - the most nodes ever allocated at once
+ * :slabs - slabs currently allocated
+ * :slab_bytes - bytes allocated for slabs
+ * :empty_bytes - bytes of slabs retained without any node in use
+ */
+static VALUE
+Coolio_Buffer_pool_stats(VALUE klass)
+{
+    VALUE stats = rb_hash_new();
+
+    rb_hash_aset(stats, ID2SYM(rb_intern("allocated")), SIZET2NUM(pool_stats.allocated));
+    rb_hash_aset(stats, ID2SYM(rb_intern("cached")), SIZET2NUM(pool_stats.cached));
+    rb_hash_aset(stats, ID2SYM(rb_intern("peak")), SIZET2NUM(pool_stats.peak));
+    rb_hash_aset(stats, ID2SYM(rb_intern("slabs")), SIZET2NUM(pool_stats.slabs));
+    rb_hash_aset(stats, ID2SYM(rb_intern("slab_bytes")), SIZET2NUM(pool_stats.slab_bytes));
+    rb_hash_aset(stats, ID2SYM(rb_intern("empty_bytes")), SIZET2NUM(pool_stats.empty_bytes));
+
+    return stats;
+}
+
+/**
+ * call-seq:
+ *   Coolio::Buffer.pool_retain -> Integer
+ *
+ * Retrieves how many bytes of completely unused slabs are kept for reuse.
+ */
+static VALUE
+Coolio_Buffer_pool_retain(VALUE klass)
+{
+    return SIZET2NUM(pool_retain);
+}
+
+/**
+ * call-seq:
+ *   Coolio::Buffer.pool_retain = 8388608
+ *
+ * Sets how many bytes of completely unused slabs are kept around for reuse
+ * rather than handed back as soon as their last node is freed.  Lowering
+ * it releases any empty slabs beyond the new limit right away.
+ */
+static VALUE
+Coolio_Buffer_set_pool_retain(VALUE klass, VALUE bytes)
+{
+    if (rb_funcall(bytes, rb_intern("<"), 1, INT2NUM(0)) == Qtrue)
+        rb_raise(rb_eArgError, "retained bytes must not be negative");
+
+    pool_retain = NUM2SIZET(bytes);
+    buffer_pool_trim(pool_retain);
+
+    return bytes;
+}
+
+/**
+ * call-seq:
+ *   Coolio::Buffer.pool_hugepages -> Boolean
+ *
+ * Are new slabs mapped in hugepage sized units?
+ */
+static VALUE
+Coolio_Buffer_pool_hugepages(VALUE klass)
+{
+    return pool_hugepages ? Qtrue : Qfalse;
+}
+
+/**
+ * call-seq:
+ *   Coolio::Buffer.pool_hugepages = true
+ *
+ * Map new slabs in 2 MiB units and advise the kernel to back them with
+ * transparent hugepages, cutting TLB misses for processes that buffer a
+ * lot of data.  Only takes effect on platforms supporting
+ * madvise(MADV_HUGEPAGE), elsewhere it stays false.
+ */
+static VALUE
+Coolio_Buffer_set_pool_hugepages(VALUE klass, VALUE enabled)
+{
+#ifdef HUGEPAGE_SIZE
+    pool_hugepages = RTEST(enabled);
+#endif
+
+    return enabled;
+}
+
+/**
+ * call-seq:
+ *   Coolio::Buffer.trim_pool -> Integer
+ *
+ * Release every slab without any node in use, returning the number of
+ * bytes released.
+ */
+static VALUE
+Coolio_Buffer_trim_pool(VALUE klass)
+{
+    return SIZET2NUM(buffer_pool_trim(0));
+}
+
 /**
  *  call-seq:
  *    Coolio::Buffer.new(size = Coolio::Buffer.default_node_size) -> Coolio::Buffer
  *
- * Create a new Coolio::Buffer with linked segments of the given size
+ * Create a new Coolio::Buffer with linked segments of at most the given size
  */
 static VALUE
 Coolio_Buffer_initialize(int argc, VALUE * argv, VALUE self)
@@ -205,7 +436,6 @@ Coolio_Buffer_initialize(int argc, VALUE * argv, VALUE self)
          * has been allocated
          */
         assert(!buf->head);
-        assert(!buf->pool_head);
 
         buf->node_size = convert_node_size(node_size_obj);
     }
@@ -263,7 +493,9 @@ Coolio_Buffer_empty(VALUE self)
  *  call-seq:
  *    Coolio::Buffer#append(data) -> String
  *
- * Append the given data to the end of the buffer
+ * Append the given data to the end of the buffer.  Frozen Strings of at
+ * least a full node are referenced rather than copied, and written out
+ * straight from the String's memory.
  */
 static VALUE
 Coolio_Buffer_append(VALUE self, VALUE data)
@@ -273,7 +505,11 @@ Coolio_Buffer_append(VALUE self, VALUE data)
 
     /* Is this needed?  Never seen anyone else do it... */
     data = rb_convert_type(data, T_STRING, "String", "to_str");
-    buffer_append(buf, RSTRING_PTR(data), RSTRING_LEN(data));
+
+    if (OBJ_FROZEN(data) && RSTRING_LEN(data) >= (long) buf->node_size)
+        buffer_append_external(buf, data, 0, RSTRING_LEN(data));
+    else
+        buffer_append(buf, RSTRING_PTR(data), RSTRING_LEN(data));
 
     return data;
 }
@@ -359,6 +595,90 @@ Coolio_Buffer_read_frame(VALUE self, VALUE data, VALUE mark)
     }
 }
 
+/* Remove a frame ending in delim from the front of the buffer, or nil */
+static VALUE
+Coolio_Buffer_take_frame(struct buffer *buf, VALUE delim, int chomp)
+{
+    VALUE str;
+    long offset;
+    unsigned len = RSTRING_LEN(delim);
+
+    offset = buffer_find(buf, (unsigned char *) RSTRING_PTR(delim), len);
+    if (offset < 0)
+        return Qnil;
+
+    if (!chomp)
+        offset += len;
+
+    str = rb_str_new(0, offset);
+    buffer_read(buf, RSTRING_PTR(str), offset);
+    if (chomp)
+        buffer_discard(buf, len);
+
+    return str;
+}
+
+static VALUE
+Coolio_Buffer_delimiter(VALUE delim)
+{
+    delim = rb_str_new_frozen(rb_convert_type(delim, T_STRING, "String", "to_str"));
+
+    if (RSTRING_LEN(delim) < 1)
+        rb_raise(rb_eArgError, "delimiter must not be empty");
+
+    return delim;
+}
+
+/**
+ *  call-seq:
+ *    Coolio::Buffer#read_until(delimiter, chomp = false) -> String or nil
+ *
+ * Remove and return the data up to and including the first occurrence of
+ * delimiter, which may be several bytes long and span nodes.  With chomp
+ * the delimiter is removed but left out of the String.  Returns nil,
+ * leaving the buffer untouched, if no complete frame has been buffered.
+ */
+static VALUE
+Coolio_Buffer_read_until(int argc, VALUE * argv, VALUE self)
+{
+    VALUE delim, chomp;
+    struct buffer *buf;
+
+    TypedData_Get_Struct(self, struct buffer, &Coolio_Buffer_type, buf);
+    rb_scan_args(argc, argv, "11", &delim, &chomp);
+
+    return Coolio_Buffer_take_frame(buf, Coolio_Buffer_delimiter(delim), RTEST(chomp));
+}
+
+/**
+ *  call-seq:
+ *    Coolio::Buffer#each_frame(delimiter, chomp = false) { |frame| ... } -> Integer
+ *
+ * Remove each complete frame ending in delimiter from the buffer and
+ * yield it, as with read_until, returning the number of frames.  Data
+ * after the last delimiter stays in the buffer without being copied.
+ */
+static VALUE
+Coolio_Buffer_each_frame(int argc, VALUE * argv, VALUE self)
+{
+    VALUE delim, chomp, frame;
+    struct buffer *buf;
+    long count = 0;
+
+    RETURN_ENUMERATOR(self, argc, argv);
+
+    TypedData_Get_Struct(self, struct buffer, &Coolio_Buffer_type, buf);
+    rb_scan_args(argc, argv, "11", &delim, &chomp);
+    delim = Coolio_Buffer_delimiter(delim);
+
+    while ((frame = Coolio_Buffer_take_frame(buf, delim, RTEST(chomp))) != Qnil) {
+        rb_yield(frame);
+        count++;
+    }
+
+    return LONG2NUM(count);
+}
+
 /**
  *  call-seq:
  *    Coolio::Buffer#to_str -> String
@@ -441,6 +761,99 @@ Coolio_Buffer_write_to(VALUE self, VALUE io)
 #endif
 }
 
+static struct buffer *
+Coolio_Buffer_other(VALUE self, VALUE other)
+{
+    struct buffer *buf;
+
+    if (other == self)
+        rb_raise(rb_eArgError, "can't move data within the same buffer");
+
+    TypedData_Get_Struct(other, struct buffer, &Coolio_Buffer_type, buf);
+    return buf;
+}
+
+/**
+ *  call-seq:
+ *    Coolio::Buffer#transfer_to(other, length = nil) -> Integer
+ *
+ * Move up to length bytes (or everything) from the front of the buffer
+ * to the end of another Coolio::Buffer, returning the number of bytes
+ * moved.  Whole nodes change buffers without copying their data, only
+ * a node straddling length has its first part copied.
+ */
+static VALUE
+Coolio_Buffer_transfer_to(int argc, VALUE * argv, VALUE self)
+{
+    VALUE other, length_obj;
+    struct buffer *buf, *dst;
+    unsigned length;
+
+    TypedData_Get_Struct(self, struct buffer, &Coolio_Buffer_type, buf);
+    rb_scan_args(argc, argv, "11", &other, &length_obj);
+    dst = Coolio_Buffer_other(self, other);
+
+    length = buf->size;
+    if (length_obj != Qnil) {
+        if (NUM2LONG(length_obj) < 0)
+            rb_raise(rb_eArgError, "length must not be negative");
+        if (NUM2LONG(length_obj) < length)
+            length = NUM2LONG(length_obj);
+    }
+
+    return UINT2NUM(buffer_transfer(buf, dst, length));
+}
+
+/**
+ *  call-seq:
+ *    Coolio::Buffer#append_buffer(other) -> Integer
+ *
+ * Move all of another Coolio::Buffer's data to the end of this one,
+ * returning the number of bytes moved.  The other buffer is left empty.
+ * Nodes change buffers without copying their data.
+ */
+static VALUE
+Coolio_Buffer_append_buffer(VALUE self, VALUE other)
+{
+    struct buffer *buf, *src;
+
+    TypedData_Get_Struct(self, struct buffer, &Coolio_Buffer_type, buf);
+    src = Coolio_Buffer_other(self, other);
+
+    return UINT2NUM(buffer_transfer(src, buf, src->size));
+}
+
+/**
+ *  call-seq:
+ *    Coolio::Buffer#split(length) -> Coolio::Buffer
+ *
+ * Remove the first length bytes from the buffer and return them as a new
+ * Coolio::Buffer with the same node size.  Only the node straddling
+ * length is copied.
+ */
+static VALUE
+Coolio_Buffer_split(VALUE self, VALUE length_obj)
+{
+    VALUE other;
+    struct buffer *buf, *dst;
+    long length = NUM2LONG(length_obj);
+
+    TypedData_Get_Struct(self, struct buffer, &Coolio_Buffer_type, buf);
+
+    if (length < 0)
+        rb_raise(rb_eArgError, "length must not be negative");
+    if (length > buf->size)
+        length = buf->size;
+
+    other = Coolio_Buffer_allocate(CLASS_OF(self));
+    TypedData_Get_Struct(other, struct buffer, &Coolio_Buffer_type, dst);
+    dst->node_size = buf->node_size;
+
+    buffer_transfer(buf, dst, length);
+
+    return other;
+}
+
 /*
  * Ruby bindings end here.  Below is the actual implementation of
  * the underlying byte queue ADT
@@ -450,9 +863,10 @@ Coolio_Buffer_write_to(VALUE self, VALUE io)
 static struct buffer *
 buffer_init(struct buffer *buf)
 {
-    buf->head = buf->tail = buf->pool_head = buf->pool_tail = 0;
+    buf->head = buf->tail = 0;
     buf->size = 0;
     buf->node_size = default_node_size;
+    buf->external = 0;
 
     return buf;
 }
@@ -461,14 +875,14 @@ buffer_init(struct buffer *buf)
 static void
 buffer_clear(struct buffer * buf)
 {
-    /* Move everything into the buffer pool */
-    if (!buf->pool_tail) {
-        buf->pool_head = buf->pool_tail = buf->head;
-    } else {
-        buf->pool_tail->next = buf->head;
+    struct buffer_node *node;
+
+    while ((node = buf->head)) {
+        buf->head = node->next;
+        buffer_node_free(buf, node);
     }
 
-    buf->head = buf->tail = 0;
+    buf->tail = 0;
     buf->size = 0;
 }
 
@@ -477,124 +891,298 @@ static void
 buffer_free(struct buffer * buf)
 {
     buffer_clear(buf);
-    buffer_free_pool(buf);
 
     xfree(buf);
 }
 
-/* Free the memory pool */
+/* Find the pool for nodes of the given size, creating it if needed */
+static struct buffer_pool *
+buffer_pool_get(unsigned node_size)
+{
+    struct buffer_pool *pool;
+
+    for (pool = buffer_pools; pool; pool = pool->next)
+        if (pool->node_size == node_size)
+            return pool;
+
+    pool = (struct buffer_pool *) xmalloc(sizeof(struct buffer_pool));
+    pool->node_size = node_size;
+    pool->node_bytes = (sizeof(struct buffer_node) + node_size + sizeof(void *) - 1) & ~(sizeof(void *) - 1);
+    pool->partial = pool->empty = 0;
+    pool->next = buffer_pools;
+    buffer_pools = pool;
+
+    return pool;
+}
+
 static void
-buffer_free_pool(struct buffer * buf)
+buffer_slab_link(struct buffer_slab **list, struct buffer_slab *slab)
 {
-    struct buffer_node *tmp;
+    slab->prev = 0;
+    slab->next = *list;
+    if (*list)
+        (*list)->prev = slab;
+    *list = slab;
+}
+
+static void
+buffer_slab_unlink(struct buffer_slab **list, struct buffer_slab *slab)
+{
+    if (slab->prev)
+        slab->prev->next = slab->next;
+    else
+        *list = slab->next;
+    if (slab->next)
+        slab->next->prev = slab->prev;
+
+    slab->prev = slab->next = 0;
+}
+
+/* Carve a new slab into nodes, it starts out on the pool's empty list */
+static struct buffer_slab *
+buffer_slab_new(struct buffer_pool *pool)
+{
+    struct buffer_slab *slab = 0;
+    struct buffer_node *node;
+    size_t header = (sizeof(struct buffer_slab) + sizeof(void *) - 1) & ~(sizeof(void *) - 1);
+    size_t bytes = SLAB_SIZE;
+    unsigned i;
+    int mapped = 0;
+
+    if (bytes < header + pool->node_bytes)
+        bytes = header + pool->node_bytes;
+
+#ifdef HUGEPAGE_SIZE
+    if (pool_hugepages) {
+        char *region, *aligned;
+
+        /* Over-map so that the slab can be aligned to a hugepage boundary */
+        bytes = (bytes + HUGEPAGE_SIZE - 1) & ~((size_t) HUGEPAGE_SIZE - 1);
+        region = mmap(0, bytes + HUGEPAGE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+        if (region != MAP_FAILED) {
+            aligned = (char *) (((uintptr_t) region + HUGEPAGE_SIZE - 1) & ~((uintptr_t) HUGEPAGE_SIZE - 1));
+            if (aligned > region)
+                munmap(region, aligned - region);
+            munmap(aligned + bytes, region + HUGEPAGE_SIZE - aligned);
+
+            madvise(aligned, bytes, MADV_HUGEPAGE);
+            slab = (struct buffer_slab *) aligned;
+            mapped = 1;
+        }
+    }
+#endif
+
+    if (!slab)
+        slab = (struct buffer_slab *) xmalloc(bytes);
+
+    slab->pool = pool;
+    slab->prev = slab->next = 0;
+    slab->free = 0;
+    slab->node_count = slab->free_count = (bytes - header) / pool->node_bytes;
+    slab->bytes = bytes;
+    slab->mapped = mapped;
+
+    for (i = slab->node_count; i > 0; i--) {
+        node = (struct buffer_node *) ((char *) slab + header + (i - 1) * pool->node_bytes);
+        node->slab = slab;
+        node->size = pool->node_size;
+        node->next = slab->free;
+        slab->free = node;
+    }
+
+    buffer_slab_link(&pool->empty, slab);
 
-    while (buf->pool_head) {
-        tmp = buf->pool_head;
-        buf->pool_head = tmp->next;
-        xfree(tmp);
+    pool_stats.slabs++;
+    pool_stats.slab_bytes += bytes;
+    pool_stats.empty_bytes += bytes;
+    pool_stats.cached += slab->node_count;
+
+    return slab;
+}
+
+/* Hand an empty slab back to the system */
+static void
+buffer_slab_release(struct buffer_slab *slab)
+{
+    pool_stats.slabs--;
+    pool_stats.slab_bytes -= slab->bytes;
+    pool_stats.cached -= slab->node_count;
+
+#ifdef HUGEPAGE_SIZE
+    if (slab->mapped) {
+        munmap(slab, slab->bytes);
+        return;
     }
+#endif
 
-    buf->pool_tail = 0;
+    xfree(slab);
+}
+
+/* Release empty slabs until no more than retain bytes of them are left */
+static size_t
+buffer_pool_trim(size_t retain)
+{
+    struct buffer_pool *pool;
+    struct buffer_slab *slab;
+    size_t released = 0;
+
+    for (pool = buffer_pools; pool && pool_stats.empty_bytes > retain; pool = pool->next) {
+        while ((slab = pool->empty) && pool_stats.empty_bytes > retain) {
+            buffer_slab_unlink(&pool->empty, slab);
+            pool_stats.empty_bytes -= slab->bytes;
+            released += slab->bytes;
+            buffer_slab_release(slab);
+        }
+    }
+
+    return released;
+}
+
+/* Size of the smallest node class holding len bytes, at most node_size */
+static unsigned
+buffer_node_size(struct buffer * buf, unsigned len)
+{
+    unsigned size = MIN_NODE_SIZE;
+
+    while (size < len && size < buf->node_size)
+        size <<= 1;
+
+    return size < buf->node_size ? size : buf->node_size;
 }
 
 /* Create a new buffer_node (or pull one from the memory pool) */
 static struct buffer_node *
-buffer_node_new(struct buffer * buf)
+buffer_node_new(struct buffer * buf, unsigned size)
 {
+    struct buffer_pool *pool = buffer_pool_get(size);
+    struct buffer_slab *slab;
     struct buffer_node *node;
 
-    /* Pull from the memory pool if available */
-    if (buf->pool_head) {
-        node = buf->pool_head;
-        buf->pool_head = node->next;
+    /* Fill up partially used slabs before breaking into empty ones */
+    if (!(slab = pool->partial)) {
+        if (!(slab = pool->empty))
+            slab = buffer_slab_new(pool);
 
-        if (node->next)
-            node->next = 0;
-        else
-            buf->pool_tail = 0;
-    } else {
-        node = (struct buffer_node *) xmalloc(sizeof(struct buffer_node) + buf->node_size);
-        node->next = 0;
+        buffer_slab_unlink(&pool->empty, slab);
+        pool_stats.empty_bytes -= slab->bytes;
+        if (slab->node_count > 1)
+            buffer_slab_link(&pool->partial, slab);
     }
 
+    node = slab->free;
+    slab->free = node->next;
+    if (--slab->free_count == 0 && slab->node_count > 1)
+        buffer_slab_unlink(&pool->partial, slab);
+
+    pool_stats.cached--;
+    if (++pool_stats.allocated > pool_stats.peak)
+        pool_stats.peak = pool_stats.allocated;
+
     node->start = node->end = 0;
+    node->external = 0;
+    node->next = 0;
     return node;
 }
 
-/* Free a buffer node (i.e. return it to the memory pool) */
+/* Free a buffer node (i.e. return it to its slab) */
 static void
 buffer_node_free(struct buffer * buf, struct buffer_node * node)
 {
-    node->next = buf->pool_head;
-    buf->pool_head = node;
+    struct buffer_slab *slab = node->slab;
+    struct buffer_pool *pool = slab->pool;
+
+    if (node->external) {
+        buf->external--;
+        node->size = pool->node_size;
+    }
 
-    if (!buf->pool_tail) {
-        buf->pool_tail = node;
+    node->next = slab->free;
+    slab->free = node;
+    slab->free_count++;
+
+    pool_stats.allocated--;
+    pool_stats.cached++;
+
+    if (slab->free_count < slab->node_count) {
+        /* A full slab has a free node again */
+        if (slab->free_count == 1)
+            buffer_slab_link(&pool->partial, slab);
+        return;
     }
+
+    if (slab->node_count > 1)
+        buffer_slab_unlink(&pool->partial, slab);
+
+    if (pool_stats.empty_bytes + slab->bytes <= pool_retain) {
+        buffer_slab_link(&pool->empty, slab);
+        pool_stats.empty_bytes += slab->bytes;
+    } else
+        buffer_slab_release(slab);
 }
 
 /* Prepend data to the front of the buffer */
 static void
 buffer_prepend(struct buffer * buf, char *str, unsigned len)
 {
-    struct buffer_node *node, *tmp;
+    struct buffer_node *node, *prev = 0, *next = buf->head;
+    unsigned nbytes;
+
+    if (len == 0)
+        return;
+
     buf->size += len;
 
     /* If it fits in the beginning of the head */
-    if (buf->head && buf->head->start >= len) {
+    if (buf->head && !buf->head->external && buf->head->start >= len) {
         buf->head->start -= len;
         memcpy(buf->head->data + buf->head->start, str, len);
-    } else {
-        node = buffer_node_new(buf);
-        node->next = buf->head;
-        buf->head = node;
-        if (!buf->tail)
-            buf->tail = node;
-
-        while (len > buf->node_size) {
-            memcpy(node->data, str, buf->node_size);
-            node->end = buf->node_size;
-
-            tmp = buffer_node_new(buf);
-            tmp->next = node->next;
-            node->next = tmp;
+        return;
+    }
 
-            if (buf->tail == node)
-                buf->tail = tmp;
-            node = tmp;
+    /* Build links out of the data in front of the old head */
+    while (len > 0) {
+        nbytes = len < buf->node_size ? len : buf->node_size;
+        node = buffer_node_new(buf, buffer_node_size(buf, nbytes));
 
-            str += buf->node_size;
-            len -= buf->node_size;
-        }
+        memcpy(node->data, str, nbytes);
+        node->end = nbytes;
+        str += nbytes;
+        len -= nbytes;
 
-        if (len > 0) {
-            memcpy(node->data, str, len);
-            node->end = len;
-        }
+        if (prev)
+            prev->next = node;
+        else
+            buf->head = node;
+        prev = node;
     }
+
+    prev->next = next;
+    if (!buf->tail)
+        buf->tail = prev;
 }
 
 /* Append data to the front of the buffer */
 static void
 buffer_append(struct buffer * buf, char *str, unsigned len)
 {
-    unsigned nbytes;
+    unsigned nbytes, size;
     buf->size += len;
 
     /* If it fits in the remaining space in the tail */
-    if (buf->tail && len <= buf->node_size - buf->tail->end) {
+    if (buf->tail && len <= buf->tail->size - buf->tail->end) {
         memcpy(buf->tail->data + buf->tail->end, str, len);
         buf->tail->end += len;
         return;
     }
     /* Empty list needs initialized */
     if (!buf->head) {
-        buf->head = buffer_node_new(buf);
+        buf->head = buffer_node_new(buf, buffer_node_size(buf, len));
         buf->tail = buf->head;
     }
     /* Build links out of the data */
     while (len > 0) {
-        nbytes = buf->node_size - buf->tail->end;
+        nbytes = buf->tail->size - buf->tail->end;
         if (len < nbytes)
             nbytes = len;
 
@@ -605,12 +1193,90 @@ buffer_append(struct buffer * buf, char *str, unsigned len)
         buf->tail->end += nbytes;
 
         if (len > 0) {
-            buf->tail->next = buffer_node_new(buf);
+            /* Grow geometrically so a run of small appends doesn't turn
+             * into a long chain of small nodes */
+            size = buf->tail->size * 2;
+            if (size < len)
+                size = len;
+
+            buf->tail->next = buffer_node_new(buf, buffer_node_size(buf, size));
             buf->tail = buf->tail->next;
         }
     }
 }
 
+/* Append bytes start to end of a frozen String by reference */
+static void
+buffer_append_external(struct buffer * buf, VALUE str, unsigned start, unsigned end)
+{
+    struct buffer_node *node = buffer_node_new(buf, sizeof(VALUE));
+
+    *(VALUE *) node->data = str;
+    node->external = 1;
+    node->start = start;
+    node->end = node->size = end;
+    buf->external++;
+    buf->size += end - start;
+
+    if (buf->tail)
+        buf->tail->next = node;
+    else
+        buf->head = node;
+    buf->tail = node;
+}
+
+/*
+ * Move len bytes from the front of one buffer to the end of another.  Whole
+ * nodes are relinked, a node straddling len has its first part copied, or
+ * for external nodes, referenced again
+ */
+static unsigned
+buffer_transfer(struct buffer * src, struct buffer * dst, unsigned len)
+{
+    struct buffer_node *node;
+    unsigned nbytes, moved = 0;
+
+    while ((node = src->head) && node->end - node->start <= len - moved) {
+        nbytes = node->end - node->start;
+
+        src->head = node->next;
+        src->size -= nbytes;
+        node->next = 0;
+
+        if (dst->tail)
+            dst->tail->next = node;
+        else
+            dst->head = node;
+        dst->tail = node;
+        dst->size += nbytes;
+
+        if (node->external) {
+            src->external--;
+            dst->external++;
+        }
+
+        moved += nbytes;
+    }
+
+    if (!src->head)
+        src->tail = 0;
+
+    if (node && moved < len) {
+        nbytes = len - moved;
+
+        if (node->external)
+            buffer_append_external(dst, *(VALUE *) node->data, node->start, node->start + nbytes);
+        else
+            buffer_append(dst, (char *) node->data + node->start, nbytes);
+
+        node->start += nbytes;
+        src->size -= nbytes;
+        moved += nbytes;
+    }
+
+    return moved;
+}
+
 /* Read data from the buffer (and clear what we've read) */
 static void
 buffer_read(struct buffer * buf, char *str, unsigned len)
@@ -623,7 +1289,7 @@ buffer_read(struct buffer * buf, char *str, unsigned len)
         if (len < nbytes)
             nbytes = len;
 
-        memcpy(str, buf->head->data + buf->head->start, nbytes);
+        memcpy(str, NODE_DATA(buf->head) + buf->head->start, nbytes);
         str += nbytes;
         len -= nbytes;
 
@@ -654,7 +1320,7 @@ buffer_read_frame(struct buffer * buf, VALUE str, char frame_mark)
 
     while (buf->size > 0) {
         struct buffer_node *head = buf->head;
-        char           *loc, *s = head->data + head->start, *e = head->data + head->end;
+        char           *loc, *s = (char *) NODE_DATA(head) + head->start, *e = s + head->end - head->start;
         nbytes = e - s;
 
         loc = memchr(s, frame_mark, nbytes);
@@ -686,6 +1352,159 @@ buffer_read_frame(struct buffer * buf, VALUE str, char frame_mark)
     return 0;
 }
 
+/* Remove len bytes from the front of the buffer */
+static void
+buffer_discard(struct buffer * buf, unsigned len)
+{
+    unsigned nbytes;
+    struct buffer_node *tmp;
+
+    while (buf->size > 0 && len > 0) {
+        nbytes = buf->head->end - buf->head->start;
+        if (len < nbytes)
+            nbytes = len;
+
+        len -= nbytes;
+        buf->head->start += nbytes;
+        buf->size -= nbytes;
+
+        if (buf->head->start == buf->head->end) {
+            tmp = buf->head;
+            buf->head = tmp->next;
+            buffer_node_free(buf, tmp);
+
+            if (!buf->head)
+                buf->tail = 0;
+        }
+    }
+}
+
+/* Index of the lowest set bit of a nonzero mask */
+static inline unsigned
+buffer_ctz(unsigned mask)
+{
+#ifdef _MSC_VER
+    unsigned long index;
+
+    _BitScanForward(&index, mask);
+    return index;
+#else
+    return __builtin_ctz(mask);
+#endif
+}
+
+/*
+ * Offset of the first delim in the n bytes at s, or -1.  The vector loops
+ * compare a block of starting positions against the delimiter's first byte
+ * and the block len - 1 bytes further against its last byte at once, so
+ * only positions matching both are compared in full
+ */
+static long
+buffer_find_in(const unsigned char *s, unsigned n, const unsigned char *delim, unsigned len)
+{
+    const unsigned char *found;
+    unsigned i = 0, last, mask;
+
+    if (n < len)
+        return -1;
+    last = n - len;
+
+#if defined(__AVX2__)
+    {
+        __m256i first = _mm256_set1_epi8((char) delim[0]);
+        __m256i final = _mm256_set1_epi8((char) delim[len - 1]);
+
+        for (; i + 32 <= last + 1; i += 32) {
+            __m256i a = _mm256_loadu_si256((const __m256i *) (s + i));
+            __m256i b = _mm256_loadu_si256((const __m256i *) (s + i + len - 1));
+
+            mask = _mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(a, first), _mm256_cmpeq_epi8(b, final)));
+            for (; mask; mask &= mask - 1)
+                if (len < 3 || !memcmp(s + i + buffer_ctz(mask) + 1, delim + 1, len - 2))
+                    return i + buffer_ctz(mask);
+        }
+    }
+#endif
+#if defined(__AVX2__) || defined(__SSE2__) || defined(_M_X64)
+    {
+        __m128i first = _mm_set1_epi8((char) delim[0]);
+        __m128i final = _mm_set1_epi8((char) delim[len - 1]);
+
+        for (; i + 16 <= last + 1; i += 16) {
+            __m128i a = _mm_loadu_si128((const __m128i *) (s + i));
+            __m128i b = _mm_loadu_si128((const __m128i *) (s + i + len - 1));
+
+            mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(a, first), _mm_cmpeq_epi8(b, final)));
+            for (; mask; mask &= mask - 1)
+                if (len < 3 || !memcmp(s + i + buffer_ctz(mask) + 1, delim + 1, len - 2))
+                    return i + buffer_ctz(mask);
+        }
+    }
+#endif
+
+    /* Whatever the vector loops left, or everything without them */
+    for (; i <= last; i++) {
+        if (!(found = memchr(s + i, delim[0], last - i + 1)))
+            return -1;
+
+        i = found - s;
+        if (s[i + len - 1] == delim[len - 1] && !memcmp(s + i, delim, len))
+            return i;
+    }
+
+    return -1;
+}
+
+/* Does delim start at offset pos of node, running on into the following nodes? */
+static int
+buffer_match_at(struct buffer_node *node, unsigned pos, const unsigned char *delim, unsigned len)
+{
+    const unsigned char *data;
+    unsigned i = 0;
+
+    while (node) {
+        data = NODE_DATA(node);
+        for (; pos < node->end; pos++, i++) {
+            if (i == len)
+                return 1;
+            if (data[pos] != delim[i])
+                return 0;
+        }
+
+        if ((node = node->next))
+            pos = node->start;
+    }
+
+    return i == len;
+}
+
+/* Offset from the front of the buffer of the first delim, or -1 */
+static long
+buffer_find(struct buffer * buf, const unsigned char *delim, unsigned len)
+{
+    struct buffer_node *node;
+    const unsigned char *s;
+    unsigned i, n;
+    long offset = 0, found;
+
+    for (node = buf->head; node; node = node->next) {
+        s = NODE_DATA(node) + node->start;
+        n = node->end - node->start;
+
+        if ((found = buffer_find_in(s, n, delim, len)) >= 0)
+            return offset + found;
+
+        /* Delimiters starting too close to the end of the node to fit in it */
+        for (i = n >= len ? n - len + 1 : 0; i < n; i++)
+            if (s[i] == delim[0] && buffer_match_at(node, node->start + i, delim, len))
+                return offset + i;
+
+        offset += n;
+    }
+
+    return -1;
+}
+
 /* Copy data from the buffer without clearing it */
 static void
 buffer_copy(struct buffer * buf, char *str, unsigned len)
@@ -699,7 +1518,7 @@ buffer_copy(struct buffer * buf, char *str, unsigned len)
         if (len < nbytes)
             nbytes = len;
 
-        memcpy(str, node->data + node->start, nbytes);
+        memcpy(str, NODE_DATA(node) + node->start, nbytes);
         str += nbytes;
         len -= nbytes;
 
@@ -709,6 +1528,65 @@ buffer_copy(struct buffer * buf, char *str, unsigned len)
 }
 
 /* Write data from the buffer to a file descriptor */
+#ifdef HAVE_SYS_UIO_H
+static int
+buffer_write_to(struct buffer * buf, int fd)
+{
+    struct iovec    iov[MAX_WRITEV_NODES];
+    struct buffer_node *node, *tmp;
+    int             iovcnt, blocked;
+    ssize_t         bytes_written, bytes_requested;
+    int             total_bytes_written = 0;
+
+    while (buf->head) {
+        /* Gather as many nodes as possible into a single system call */
+        bytes_requested = 0;
+        for (node = buf->head, iovcnt = 0; node && iovcnt < MAX_WRITEV_NODES; node = node->next, iovcnt++) {
+            iov[iovcnt].iov_base = NODE_DATA(node) + node->start;
+            iov[iovcnt].iov_len = node->end - node->start;
+            bytes_requested += node->end - node->start;
+        }
+
+        bytes_written = writev(fd, iov, iovcnt);
+
+        /* If the write failed... */
+        if (bytes_written < 0) {
+            if (errno != EAGAIN)
+                rb_sys_fail("writev");
+
+            return total_bytes_written;
+        }
+
+        total_bytes_written += bytes_written;
+        buf->size -= bytes_written;
+
+        /* If the write blocked... */
+        blocked = bytes_written < bytes_requested;
+
+        /* Release the nodes which were written completely, the write may
+         * have stopped anywhere inside the last node it touched */
+        while (buf->head && buf->head->end - buf->head->start <= bytes_written) {
+            bytes_written -= buf->head->end - buf->head->start;
+
+            tmp = buf->head;
+            buf->head = tmp->next;
+            buffer_node_free(buf, tmp);
+        }
+
+        if (!buf->head) {
+            buf->tail = 0;
+            break;
+        }
+
+        buf->head->start += bytes_written;
+
+        if (blocked)
+            return total_bytes_written;
+    }
+
+    return total_bytes_written;
+}
+#else
 static int
 buffer_write_to(struct buffer * buf, int fd)
 {
@@ -716,7 +1594,7 @@ buffer_write_to(struct buffer * buf, int fd)
     struct buffer_node *tmp;
 
     while (buf->head) {
-        bytes_written = write(fd, buf->head->data + buf->head->start, buf->head->end - buf->head->start);
+        bytes_written = write(fd, NODE_DATA(buf->head) + buf->head->start, buf->head->end - buf->head->start);
 
         /* If the write failed... */
         if (bytes_written < 0) {
@@ -745,6 +1623,7 @@ buffer_write_to(struct buffer * buf, int fd)
 
     return total_bytes_written;
 }
+#endif
 
 /* Read data from a file descriptor to a buffer */
 /* Append data to the front of the buffer */
@@ -754,14 +1633,18 @@ buffer_read_from(struct buffer * buf, int fd)
     int      bytes_read, total_bytes_read = 0;
     unsigned nbytes;
 
-    /* Empty list needs initialized */
+    /* Read into full sized nodes, starting a new one rather than
+     * trickling into whatever small node the tail is */
     if (!buf->head) {
-        buf->head = buffer_node_new(buf);
+        buf->head = buffer_node_new(buf, buf->node_size);
         buf->tail = buf->head;
+    } else if (buf->tail->size < buf->node_size || buf->tail->end == buf->tail->size) {
+        buf->tail->next = buffer_node_new(buf, buf->node_size);
+        buf->tail = buf->tail->next;
     }
 
     do {
-        nbytes = buf->node_size - buf->tail->end;
+        nbytes = buf->tail->size - buf->tail->end;
         bytes_read = read(fd, buf->tail->data + buf->tail->end, nbytes);
 
         if (bytes_read == 0) {
@@ -778,8 +1661,8 @@ buffer_read_from(struct buffer * buf, int fd)
         buf->tail->end += bytes_read;
         buf->size += bytes_read;
 
-        if (buf->tail->end == buf->node_size) {
-            buf->tail->next = buffer_node_new(buf);
+        if (buf->tail->end == buf->tail->size) {
+            buf->tail->next = buffer_node_new(buf, buf->node_size);
             buf->tail = buf->tail->next;
         }
     } while (bytes_read == nbytes);
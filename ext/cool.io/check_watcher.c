@@ -0,0 +1,178 @@
+/*
+ * Copyright (C) 2007-10 Tony Arcieri
+ * You may redistribute this under the terms of the Ruby license.
+ * See LICENSE for details
+ */
+
+#include "ruby.h"
+#include "ev_wrap.h"
+
+#include "cool.io.h"
+#include "watcher.h"
+
+static VALUE mCoolio = Qnil;
+static VALUE cCoolio_Watcher = Qnil;
+static VALUE cCoolio_CheckWatcher = Qnil;
+static VALUE cCoolio_Loop = Qnil;
+
+static VALUE Coolio_CheckWatcher_allocate(VALUE klass);
+static size_t Coolio_CheckWatcher_memsize(const void *data);
+
+static VALUE Coolio_CheckWatcher_initialize(VALUE self);
+static VALUE Coolio_CheckWatcher_attach(VALUE self, VALUE loop);
+static VALUE Coolio_CheckWatcher_detach(VALUE self);
+static VALUE Coolio_CheckWatcher_enable(VALUE self);
+static VALUE Coolio_CheckWatcher_disable(VALUE self);
+static VALUE Coolio_CheckWatcher_on_check(VALUE self);
+
+static void Coolio_CheckWatcher_libev_callback(struct ev_loop *ev_loop, struct ev_check *check, int revents);
+static void Coolio_CheckWatcher_dispatch_callback(VALUE self, int revents);
+
+/*
+ * Coolio::CheckWatcher calls on_check once per loop iteration, after the
+ * callbacks for all other events received during that iteration.  This
+ * makes it a good place to flush work which the other callbacks only
+ * queue up, such as coalesced writes.
+ */
+void Init_coolio_check_watcher()
+{
+  mCoolio = rb_define_module("Coolio");
+  cCoolio_Watcher = rb_define_class_under(mCoolio, "Watcher", rb_cObject);
+  cCoolio_CheckWatcher = rb_define_class_under(mCoolio, "CheckWatcher", cCoolio_Watcher);
+  rb_define_alloc_func(cCoolio_CheckWatcher, Coolio_CheckWatcher_allocate);
+  cCoolio_Loop = rb_define_class_under(mCoolio, "Loop", rb_cObject);
+
+  rb_define_method(cCoolio_CheckWatcher, "initialize", Coolio_CheckWatcher_initialize, 0);
+  rb_define_method(cCoolio_CheckWatcher, "attach", Coolio_CheckWatcher_attach, 1);
+  rb_define_method(cCoolio_CheckWatcher, "detach", Coolio_CheckWatcher_detach, 0);
+  rb_define_method(cCoolio_CheckWatcher, "enable", Coolio_CheckWatcher_enable, 0);
+  rb_define_method(cCoolio_CheckWatcher, "disable", Coolio_CheckWatcher_disable, 0);
+  rb_define_method(cCoolio_CheckWatcher, "on_check", Coolio_CheckWatcher_on_check, 0);
+}
+
+static const rb_data_type_t Coolio_CheckWatcher_type = {
+  "Coolio::CheckWatcher",
+  {
+    Coolio_Watcher_mark,
+    RUBY_DEFAULT_FREE,
+    Coolio_CheckWatcher_memsize,
+  },
+  &Coolio_Watcher_type,
+};
+
+static VALUE Coolio_CheckWatcher_allocate(VALUE klass)
+{
+  struct Coolio_Watcher_check *watcher_data;
+  VALUE watcher = TypedData_Make_Struct(klass, struct Coolio_Watcher_check, &Coolio_CheckWatcher_type, watcher_data);
+
+  Coolio_Watcher_setup(watcher, &watcher_data->watcher);
+
+  return watcher;
+}
+
+static size_t Coolio_CheckWatcher_memsize(const void *data)
+{
+  return sizeof(struct Coolio_Watcher_check);
+}
+
+/**
+ *  call-seq:
+ *    Coolio::CheckWatcher.initialize -> Coolio::CheckWatcher
+ *
+ * Create a new Coolio::CheckWatcher
+ */
+static VALUE Coolio_CheckWatcher_initialize(VALUE self)
+{
+  struct Coolio_Watcher *watcher_data = Coolio_Watcher_ptr(self);
+
+  watcher_data->dispatch_callback = Coolio_CheckWatcher_dispatch_callback;
+  ev_check_init(Coolio_Watcher_ev(watcher_data, check), Coolio_CheckWatcher_libev_callback);
+
+  /* libev runs the pending watchers of each priority newest first, so at
+   * the default priority checks would be dispatched before other events */
+  ev_set_priority(Coolio_Watcher_ev(watcher_data, check), EV_MINPRI);
+  Coolio_Watcher_ev(watcher_data, check)->data = (void *)self;
+
+  return Qnil;
+}
+
+/**
+ *  call-seq:
+ *    Coolio::CheckWatcher.attach(loop) -> Coolio::CheckWatcher
+ *
+ * Attach the check watcher to the given Coolio::Loop.  If the watcher is already
+ * attached to a loop, detach it from the old one and attach it to the new one.
+ */
+static VALUE Coolio_CheckWatcher_attach(VALUE self, VALUE loop)
+{
+  Watcher_Attach(check, Coolio_CheckWatcher_detach, self, loop);
+
+  return self;
+}
+
+/**
+ *  call-seq:
+ *    Coolio::CheckWatcher.detach -> Coolio::CheckWatcher
+ *
+ * Detach the check watcher from its current Coolio::Loop.
+ */
+static VALUE Coolio_CheckWatcher_detach(VALUE self)
+{
+  Watcher_Detach(check, self);
+
+  return self;
+}
+
+/**
+ *  call-seq:
+ *    Coolio::CheckWatcher.enable -> Coolio::CheckWatcher
+ *
+ * Re-enable a check watcher which has been temporarily disabled.  See the
+ * disable method for a more thorough explanation.
+ */
+static VALUE Coolio_CheckWatcher_enable(VALUE self)
+{
+  Watcher_Enable(check, self);
+
+  return self;
+}
+
+/**
+ *  call-seq:
+ *    Coolio::CheckWatcher.disable -> Coolio::CheckWatcher
+ *
+ * Temporarily disable a check watcher which is attached to a loop.
+ * This is useful if you wish to toggle event monitoring on and off.
+ */
+static VALUE Coolio_CheckWatcher_disable(VALUE self)
+{
+  Watcher_Disable(check, self);
+
+  return self;
+}
+
+/**
+ *  call-seq:
+ *    Coolio::CheckWatcher#on_check -> nil
+ *
+ * Called once per loop iteration, after the other callbacks of the iteration
+ */
+static VALUE Coolio_CheckWatcher_on_check(VALUE self)
+{
+  return Qnil;
+}
+
+/* libev callback */
+static void Coolio_CheckWatcher_libev_callback(struct ev_loop *ev_loop, struct ev_check *check, int revents)
+{
+  Coolio_Loop_process_event((VALUE)check->data, revents);
+}
+
+/* Coolio::Loop dispatch callback */
+static void Coolio_CheckWatcher_dispatch_callback(VALUE self, int revents)
+{
+  if(revents & EV_CHECK)
+    rb_funcall(self, rb_intern("on_check"), 0);
+  else
+    rb_raise(rb_eRuntimeError, "unknown revents value for ev_check: %d", revents);
+}
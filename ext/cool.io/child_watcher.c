@@ -0,0 +1,229 @@
+/*
+ * Copyright (C) 2007-10 Tony Arcieri
+ * You may redistribute this under the terms of the Ruby license.
+ * See LICENSE for details
+ */
+
+#include "ruby.h"
+#include <signal.h>
+#include <errno.h>
+
+#ifndef _WIN32
+#include <sys/types.h>
+#include <sys/wait.h>
+#endif
+
+#include "ev_wrap.h"
+
+#include "cool.io.h"
+#include "watcher.h"
+
+static VALUE mCoolio = Qnil;
+static VALUE cCoolio_Watcher = Qnil;
+static VALUE cCoolio_SignalWatcher = Qnil;
+static VALUE cCoolio_ChildWatcher = Qnil;
+
+static VALUE Coolio_ChildWatcher_allocate(VALUE klass);
+static size_t Coolio_ChildWatcher_memsize(const void *data);
+
+static VALUE Coolio_ChildWatcher_initialize(VALUE self, VALUE pid);
+static VALUE Coolio_ChildWatcher_attach(VALUE self, VALUE loop);
+static VALUE Coolio_ChildWatcher_enable(VALUE self);
+static VALUE Coolio_ChildWatcher_pid(VALUE self);
+static VALUE Coolio_ChildWatcher_on_exit(VALUE self, VALUE pid, VALUE status);
+
+static void Coolio_ChildWatcher_check(VALUE self);
+static void Coolio_ChildWatcher_libev_callback(struct ev_loop *ev_loop, struct ev_signal *signal, int revents);
+static void Coolio_ChildWatcher_dispatch_callback(VALUE self, int revents);
+
+/*
+ * Coolio::ChildWatcher calls on_exit once a given child process has
+ * exited, and reaps it.  It's a Coolio::SignalWatcher for SIGCHLD which
+ * only ever waits for its own child, so the other children of the
+ * process are left for Process.wait and friends to reap.  The same goes
+ * for Process.detach: a child reaped by someone else is reported with a
+ * nil status.
+ *
+ * Like any signal watcher, child watchers take SIGCHLD over from a
+ * Signal.trap handler while enabled, and only one loop at a time may
+ * have child watchers.
+ */
+void Init_coolio_child_watcher()
+{
+  mCoolio = rb_define_module("Coolio");
+  cCoolio_Watcher = rb_define_class_under(mCoolio, "Watcher", rb_cObject);
+  cCoolio_SignalWatcher = rb_define_class_under(mCoolio, "SignalWatcher", cCoolio_Watcher);
+  cCoolio_ChildWatcher = rb_define_class_under(mCoolio, "ChildWatcher", cCoolio_SignalWatcher);
+  rb_define_alloc_func(cCoolio_ChildWatcher, Coolio_ChildWatcher_allocate);
+
+  rb_define_method(cCoolio_ChildWatcher, "initialize", Coolio_ChildWatcher_initialize, 1);
+  rb_define_method(cCoolio_ChildWatcher, "attach", Coolio_ChildWatcher_attach, 1);
+  rb_define_method(cCoolio_ChildWatcher, "enable", Coolio_ChildWatcher_enable, 0);
+  rb_define_method(cCoolio_ChildWatcher, "pid", Coolio_ChildWatcher_pid, 0);
+  rb_define_method(cCoolio_ChildWatcher, "on_exit", Coolio_ChildWatcher_on_exit, 2);
+}
+
+static const rb_data_type_t Coolio_ChildWatcher_type = {
+  "Coolio::ChildWatcher",
+  {
+    Coolio_Watcher_mark,
+    RUBY_DEFAULT_FREE,
+    Coolio_ChildWatcher_memsize,
+  },
+  &Coolio_Watcher_type,
+};
+
+static VALUE Coolio_ChildWatcher_allocate(VALUE klass)
+{
+  struct Coolio_Watcher_child *watcher_data;
+  VALUE watcher = TypedData_Make_Struct(klass, struct Coolio_Watcher_child, &Coolio_ChildWatcher_type, watcher_data);
+
+  Coolio_Watcher_setup(watcher, &watcher_data->watcher);
+
+  return watcher;
+}
+
+static size_t Coolio_ChildWatcher_memsize(const void *data)
+{
+  return sizeof(struct Coolio_Watcher_child);
+}
+
+/**
+ *  call-seq:
+ *    Coolio::ChildWatcher.initialize(pid) -> Coolio::ChildWatcher
+ *
+ * Create a new Coolio::ChildWatcher for the child process with the given pid
+ */
+static VALUE Coolio_ChildWatcher_initialize(VALUE self, VALUE pid)
+{
+#ifdef _WIN32
+  rb_notimplement();
+#else
+  struct Coolio_Watcher_child *child_data = (struct Coolio_Watcher_child *)Coolio_Watcher_ptr(self);
+
+  child_data->pid = NUM2INT(pid);
+  if(child_data->pid <= 0)
+    rb_raise(rb_eArgError, "invalid pid (%d)", child_data->pid);
+
+  child_data->exited = 0;
+  child_data->rstatus = -1;
+
+  child_data->watcher.dispatch_callback = Coolio_ChildWatcher_dispatch_callback;
+  ev_signal_init(&child_data->ev_signal, Coolio_ChildWatcher_libev_callback, SIGCHLD);
+  child_data->ev_signal.data = (void *)self;
+#endif
+
+  return Qnil;
+}
+
+/* A child which exited before we started watching won't raise SIGCHLD
+ * again, so have the loop look for it straight away */
+static void Coolio_ChildWatcher_check(VALUE self)
+{
+  struct Coolio_Watcher_child *child_data = (struct Coolio_Watcher_child *)Coolio_Watcher_ptr(self);
+  struct Coolio_Loop *loop_data = Coolio_Loop_ptr(child_data->watcher.loop);
+
+  ev_feed_event(loop_data->ev_loop, &child_data->ev_signal, EV_SIGNAL);
+
+  /* Fed events are only invoked after polling, don't let it block */
+  ev_async_send(loop_data->ev_loop, &loop_data->post_async);
+}
+
+/**
+ *  call-seq:
+ *    Coolio::ChildWatcher.attach(loop) -> Coolio::ChildWatcher
+ *
+ * Attach the child watcher to the given Coolio::Loop.  If the watcher is already
+ * attached to a loop, detach it from the old one and attach it to the new one.
+ */
+static VALUE Coolio_ChildWatcher_attach(VALUE self, VALUE loop)
+{
+  rb_call_super(1, &loop);
+  Coolio_ChildWatcher_check(self);
+
+  return self;
+}
+
+/**
+ *  call-seq:
+ *    Coolio::ChildWatcher.enable -> Coolio::ChildWatcher
+ *
+ * Re-enable a child watcher which has been temporarily disabled.  A child
+ * which exited in the meantime is reported on the next loop iteration.
+ */
+static VALUE Coolio_ChildWatcher_enable(VALUE self)
+{
+  rb_call_super(0, 0);
+  Coolio_ChildWatcher_check(self);
+
+  return self;
+}
+
+/**
+ *  call-seq:
+ *    Coolio::ChildWatcher#pid -> Integer
+ *
+ * Process ID of the child being watched
+ */
+static VALUE Coolio_ChildWatcher_pid(VALUE self)
+{
+  return INT2NUM(((struct Coolio_Watcher_child *)Coolio_Watcher_ptr(self))->pid);
+}
+
+/**
+ *  call-seq:
+ *    Coolio::ChildWatcher#on_exit(pid, status) -> nil
+ *
+ * Called with the child's pid and Process::Status once it has exited.
+ * The watcher is detached beforehand.
+ */
+static VALUE Coolio_ChildWatcher_on_exit(VALUE self, VALUE pid, VALUE status)
+{
+  return Qnil;
+}
+
+/* libev callback, run for every SIGCHLD the process receives */
+static void Coolio_ChildWatcher_libev_callback(struct ev_loop *ev_loop, struct ev_signal *signal, int revents)
+{
+#ifndef _WIN32
+  struct Coolio_Watcher_child *child_data = (struct Coolio_Watcher_child *)Coolio_Watcher_ptr((VALUE)signal->data);
+  int pid, status;
+
+  if(child_data->exited)
+    return;
+
+  do {
+    pid = waitpid(child_data->pid, &status, WNOHANG);
+  } while(pid < 0 && errno == EINTR);
+
+  /* Some other child, ours is still running */
+  if(pid == 0)
+    return;
+
+  child_data->exited = 1;
+  child_data->rstatus = pid < 0 ? -1 : status;
+
+  Coolio_Loop_process_event((VALUE)signal->data, revents);
+#endif
+}
+
+/* Coolio::Loop dispatch callback */
+static void Coolio_ChildWatcher_dispatch_callback(VALUE self, int revents)
+{
+  struct Coolio_Watcher_child *child_data = (struct Coolio_Watcher_child *)Coolio_Watcher_ptr(self);
+  VALUE status = Qnil;
+
+  if(!(revents & EV_SIGNAL))
+    rb_raise(rb_eRuntimeError, "unknown revents value for ev_signal: %d", revents);
+
+  /* There's nothing left to watch, don't keep the loop running */
+  if(child_data->watcher.loop != Qnil)
+    rb_funcall(self, rb_intern("detach"), 0);
+
+  if(child_data->rstatus != -1) {
+    rb_last_status_set(child_data->rstatus, child_data->pid);
+    status = rb_last_status_get();
+  }
+
+  rb_funcall(self, rb_intern("on_exit"), 2, INT2NUM(child_data->pid), status);
+}
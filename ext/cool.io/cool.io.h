@@ -33,6 +33,28 @@ struct Coolio_Event
   int revents;
 };
 
+/* A block posted to a loop from another thread */
+struct Coolio_Post
+{
+  VALUE block;
+  struct Coolio_Post *next;
+};
+
+/* Buckets of the events per wakeup histogram: 0, 1, 2-3, 4-7, ... */
+#define COOLIO_STATS_BUCKETS 16
+
+/* Cumulative counters reported by Coolio::Loop#stats */
+struct Coolio_Loop_stats
+{
+  unsigned long wakeups;
+  unsigned long events;
+  unsigned long events_per_wakeup[COOLIO_STATS_BUCKETS];
+  int eventbuf_high_water;
+  double poll_time;
+  double dispatch_time;
+  double poll_started;
+};
+
 struct Coolio_Loop 
 {
   struct ev_loop *ev_loop;
@@ -42,33 +64,186 @@ struct Coolio_Loop
   int events_received;
   int eventbuf_size;
   struct Coolio_Event *eventbuf;
+
+  /* Registry of attached watchers, linked through the watchers themselves */
+  struct Coolio_Watcher *watchers_head;
+  int watcher_count;
+  int active_watchers;
+
+  /* Scratch space for reads performed natively by IO watchers */
+  char *readbuf;
+
+  /* String reused for every read of IO objects on this loop, or Qnil */
+  VALUE read_buffer;
+
+  /* Blocks posted from other threads, pushed newest first without locks,
+   * and those taken off the queue but not run yet, oldest first */
+  struct Coolio_Post *posted;
+  struct Coolio_Post *posted_run;
+  size_t posted_count;
+  struct ev_async post_async; /* wakes the loop up for posted blocks */
+
+  /* How long libev waits to collect more I/O events and timeouts */
+  ev_tstamp io_collect_interval;
+  ev_tstamp timeout_collect_interval;
+
+  struct Coolio_Loop_stats stats;
 };
 
+/* Maximum number of bytes IO watchers read natively at once */
+#define COOLIO_READBUF_SIZE 16384
+
+/* Common header shared by every watcher type */
 struct Coolio_Watcher
 {
-  union {
-    struct ev_io ev_io;
-    struct ev_timer ev_timer;
-    struct ev_stat ev_stat;
-  } event_types;
-
   int enabled;
   VALUE loop;
+  VALUE self;
+
+  /* Links in the attached loop's watcher registry */
+  struct Coolio_Watcher *prev, *next;
+
+  /* Index of this watcher's pending event in the loop's eventbuf */
+  int pending_index;
 
   void (*dispatch_callback)(VALUE self, int revents);
 };
 
+/* Each watcher type is allocated with only the libev watcher it needs */
+struct Coolio_Watcher_io
+{
+  struct Coolio_Watcher watcher;
+  struct ev_io ev_io;
+
+  /* Object whose on_read receives data read natively, or Qnil */
+  VALUE read_target;
+
+  /* String reused for every read of this watcher, or Qnil */
+  VALUE read_buffer;
+
+  /* Fires once inactivity_timeout seconds have passed since last_activity,
+   * which is when the watcher last dispatched a read or write */
+  struct ev_timer inactivity_timer;
+  ev_tstamp inactivity_timeout;
+  ev_tstamp last_activity;
+};
+
+struct Coolio_Watcher_timer
+{
+  struct Coolio_Watcher watcher;
+  struct ev_timer ev_timer;
+};
+
+struct Coolio_Watcher_periodic
+{
+  struct Coolio_Watcher watcher;
+  struct ev_periodic ev_periodic;
+};
+
+/* An object with a timeout pending in a Coolio::TimerWheel */
+struct Coolio_TimerWheel_entry
+{
+  VALUE object;
+  uint64_t expires; /* tick of the wheel it expires on */
+  uint64_t linked;  /* tick of the slot it's in, expires may be later,
+                     * or COOLIO_TIMERWHEEL_EXPIRED */
+  struct Coolio_TimerWheel_entry *prev, *next;
+};
+
+/* Entries which expired but haven't been dispatched yet are in no slot */
+#define COOLIO_TIMERWHEEL_EXPIRED UINT64_MAX
+
+/* Starts like Coolio_Watcher_timer, so the timer watcher macros apply */
+struct Coolio_TimerWheel
+{
+  struct Coolio_Watcher watcher;
+  struct ev_timer ev_timer;
+
+  double resolution;
+  uint64_t tick;
+  double tick_time; /* when the current tick began, see Coolio_Loop_clock */
+
+  /* Entries are kept in the slot of the tick they expired on when they
+   * were put there, modulo the number of slots, and looked up by object */
+  struct Coolio_TimerWheel_entry **slots;
+  size_t slot_count;
+  size_t size;
+  st_table *entries;
+};
+
+struct Coolio_Watcher_stat
+{
+  struct Coolio_Watcher watcher;
+  struct ev_stat ev_stat;
+};
+
+struct Coolio_Watcher_async
+{
+  struct Coolio_Watcher watcher;
+  struct ev_async ev_async;
+};
+
+struct Coolio_Watcher_signal
+{
+  struct Coolio_Watcher watcher;
+  struct ev_signal ev_signal;
+};
+
+/* Shares its layout with Coolio_Watcher_signal, which it's a subclass of */
+struct Coolio_Watcher_child
+{
+  struct Coolio_Watcher watcher;
+  struct ev_signal ev_signal;
+  int pid, rstatus, exited;
+};
+
+struct Coolio_Watcher_idle
+{
+  struct Coolio_Watcher watcher;
+  struct ev_idle ev_idle;
+};
+
+struct Coolio_Watcher_prepare
+{
+  struct Coolio_Watcher watcher;
+  struct ev_prepare ev_prepare;
+};
+
+struct Coolio_Watcher_check
+{
+  struct Coolio_Watcher watcher;
+  struct ev_check ev_check;
+};
+
+/* Retrieve the libev watcher of the given type from a watcher header */
+#define Coolio_Watcher_ev(watcher_data, watcher_type) \
+  (&((struct Coolio_Watcher_##watcher_type *)(watcher_data))->ev_##watcher_type)
+
+extern const rb_data_type_t Coolio_Watcher_type;
+
 void Coolio_Loop_process_event(VALUE watcher, int revents);
 
 void Init_coolio_buffer();
 void Init_coolio_loop();
 void Init_coolio_watcher();
 void Init_coolio_iowatcher();
+void Init_coolio_listener();
 void Init_coolio_timer_watcher();
 void Init_coolio_stat_watcher();
+void Init_coolio_native_async_watcher();
+void Init_coolio_idle_watcher();
+void Init_coolio_prepare_watcher();
+void Init_coolio_check_watcher();
+void Init_coolio_signal_watcher();
+void Init_coolio_child_watcher();
+void Init_coolio_periodic_watcher();
+void Init_coolio_timer_wheel();
 void Init_coolio_utils();
 
 struct Coolio_Loop *Coolio_Loop_ptr(VALUE loop);
+double Coolio_Loop_clock(void);
 struct Coolio_Watcher *Coolio_Watcher_ptr(VALUE watcher);
+void Coolio_Watcher_setup(VALUE watcher, struct Coolio_Watcher *watcher_data);
+void Coolio_Watcher_mark(void *data);
 
 #endif
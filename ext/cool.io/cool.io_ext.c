@@ -20,7 +20,16 @@ void Init_cool()
   Init_coolio_loop();
   Init_coolio_watcher();
   Init_coolio_iowatcher();
+  Init_coolio_listener();
   Init_coolio_timer_watcher();
   Init_coolio_stat_watcher();
+  Init_coolio_native_async_watcher();
+  Init_coolio_idle_watcher();
+  Init_coolio_prepare_watcher();
+  Init_coolio_check_watcher();
+  Init_coolio_signal_watcher();
+  Init_coolio_child_watcher();
+  Init_coolio_periodic_watcher();
+  Init_coolio_timer_wheel();
   Init_coolio_utils();
 }
\ No newline at end of file
@@ -1,4 +1,5 @@
 #define EV_STANDALONE              /* keeps ev from requiring config.h */
+#define EV_USE_SIGNALFD 0          /* needs signals blocked in every thread, Ruby doesn't */
 
 #ifdef _WIN32
 #define EV_SELECT_IS_WINSOCKET 1   /* configure libev for windows select */
@@ -9,6 +9,7 @@ have_func('rb_thread_blocking_region')
 have_func('rb_thread_call_without_gvl')
 have_func('rb_thread_alone')
 have_func('rb_str_set_len')
+have_func('accept4', 'sys/socket.h')
 have_library('rt', 'clock_gettime')
 
 have_library("c", "main")
@@ -24,6 +25,10 @@ if have_header('ruby/thread.h')
   $defs << '-DHAVE_RUBY_THREAD_H'
 end
 
+if have_header('ruby/atomic.h')
+  $defs << '-DHAVE_RUBY_ATOMIC_H'
+end
+
 if have_header('sys/select.h')
   $defs << '-DEV_USE_SELECT'
 end
@@ -45,6 +50,8 @@ if have_header('port.h')
 end
 
 have_header('sys/resource.h')
+have_header('sys/uio.h')
+have_header('sys/mman.h')
 
 # ncpu detection specifics
 case RUBY_PLATFORM
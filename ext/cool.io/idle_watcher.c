@@ -0,0 +1,176 @@
+/*
+ * Copyright (C) 2007-10 Tony Arcieri
+ * You may redistribute this under the terms of the Ruby license.
+ * See LICENSE for details
+ */
+
+#include "ruby.h"
+#include "ev_wrap.h"
+
+#include "cool.io.h"
+#include "watcher.h"
+
+static VALUE mCoolio = Qnil;
+static VALUE cCoolio_Watcher = Qnil;
+static VALUE cCoolio_IdleWatcher = Qnil;
+static VALUE cCoolio_Loop = Qnil;
+
+static VALUE Coolio_IdleWatcher_allocate(VALUE klass);
+static size_t Coolio_IdleWatcher_memsize(const void *data);
+
+static VALUE Coolio_IdleWatcher_initialize(VALUE self);
+static VALUE Coolio_IdleWatcher_attach(VALUE self, VALUE loop);
+static VALUE Coolio_IdleWatcher_detach(VALUE self);
+static VALUE Coolio_IdleWatcher_enable(VALUE self);
+static VALUE Coolio_IdleWatcher_disable(VALUE self);
+static VALUE Coolio_IdleWatcher_on_idle(VALUE self);
+
+static void Coolio_IdleWatcher_libev_callback(struct ev_loop *ev_loop, struct ev_idle *idle, int revents);
+static void Coolio_IdleWatcher_dispatch_callback(VALUE self, int revents);
+
+/*
+ * Coolio::IdleWatcher calls on_idle once per loop iteration in which no
+ * other watcher had an event.  While it is enabled the loop polls for
+ * events without blocking, so use it for background work which should
+ * only run when the loop has nothing better to do, and disable it again
+ * once that work is done.
+ */
+void Init_coolio_idle_watcher()
+{
+  mCoolio = rb_define_module("Coolio");
+  cCoolio_Watcher = rb_define_class_under(mCoolio, "Watcher", rb_cObject);
+  cCoolio_IdleWatcher = rb_define_class_under(mCoolio, "IdleWatcher", cCoolio_Watcher);
+  rb_define_alloc_func(cCoolio_IdleWatcher, Coolio_IdleWatcher_allocate);
+  cCoolio_Loop = rb_define_class_under(mCoolio, "Loop", rb_cObject);
+
+  rb_define_method(cCoolio_IdleWatcher, "initialize", Coolio_IdleWatcher_initialize, 0);
+  rb_define_method(cCoolio_IdleWatcher, "attach", Coolio_IdleWatcher_attach, 1);
+  rb_define_method(cCoolio_IdleWatcher, "detach", Coolio_IdleWatcher_detach, 0);
+  rb_define_method(cCoolio_IdleWatcher, "enable", Coolio_IdleWatcher_enable, 0);
+  rb_define_method(cCoolio_IdleWatcher, "disable", Coolio_IdleWatcher_disable, 0);
+  rb_define_method(cCoolio_IdleWatcher, "on_idle", Coolio_IdleWatcher_on_idle, 0);
+}
+
+static const rb_data_type_t Coolio_IdleWatcher_type = {
+  "Coolio::IdleWatcher",
+  {
+    Coolio_Watcher_mark,
+    RUBY_DEFAULT_FREE,
+    Coolio_IdleWatcher_memsize,
+  },
+  &Coolio_Watcher_type,
+};
+
+static VALUE Coolio_IdleWatcher_allocate(VALUE klass)
+{
+  struct Coolio_Watcher_idle *watcher_data;
+  VALUE watcher = TypedData_Make_Struct(klass, struct Coolio_Watcher_idle, &Coolio_IdleWatcher_type, watcher_data);
+
+  Coolio_Watcher_setup(watcher, &watcher_data->watcher);
+
+  return watcher;
+}
+
+static size_t Coolio_IdleWatcher_memsize(const void *data)
+{
+  return sizeof(struct Coolio_Watcher_idle);
+}
+
+/**
+ *  call-seq:
+ *    Coolio::IdleWatcher.initialize -> Coolio::IdleWatcher
+ *
+ * Create a new Coolio::IdleWatcher
+ */
+static VALUE Coolio_IdleWatcher_initialize(VALUE self)
+{
+  struct Coolio_Watcher *watcher_data = Coolio_Watcher_ptr(self);
+
+  watcher_data->dispatch_callback = Coolio_IdleWatcher_dispatch_callback;
+  ev_idle_init(Coolio_Watcher_ev(watcher_data, idle), Coolio_IdleWatcher_libev_callback);
+  Coolio_Watcher_ev(watcher_data, idle)->data = (void *)self;
+
+  return Qnil;
+}
+
+/**
+ *  call-seq:
+ *    Coolio::IdleWatcher.attach(loop) -> Coolio::IdleWatcher
+ *
+ * Attach the idle watcher to the given Coolio::Loop.  If the watcher is already
+ * attached to a loop, detach it from the old one and attach it to the new one.
+ */
+static VALUE Coolio_IdleWatcher_attach(VALUE self, VALUE loop)
+{
+  Watcher_Attach(idle, Coolio_IdleWatcher_detach, self, loop);
+
+  return self;
+}
+
+/**
+ *  call-seq:
+ *    Coolio::IdleWatcher.detach -> Coolio::IdleWatcher
+ *
+ * Detach the idle watcher from its current Coolio::Loop.
+ */
+static VALUE Coolio_IdleWatcher_detach(VALUE self)
+{
+  Watcher_Detach(idle, self);
+
+  return self;
+}
+
+/**
+ *  call-seq:
+ *    Coolio::IdleWatcher.enable -> Coolio::IdleWatcher
+ *
+ * Re-enable an idle watcher which has been temporarily disabled.  See the
+ * disable method for a more thorough explanation.
+ */
+static VALUE Coolio_IdleWatcher_enable(VALUE self)
+{
+  Watcher_Enable(idle, self);
+
+  return self;
+}
+
+/**
+ *  call-seq:
+ *    Coolio::IdleWatcher.disable -> Coolio::IdleWatcher
+ *
+ * Temporarily disable an idle watcher which is attached to a loop.
+ * The loop blocks waiting for events again while no idle watchers are
+ * enabled.
+ */
+static VALUE Coolio_IdleWatcher_disable(VALUE self)
+{
+  Watcher_Disable(idle, self);
+
+  return self;
+}
+
+/**
+ *  call-seq:
+ *    Coolio::IdleWatcher#on_idle -> nil
+ *
+ * Called whenever the loop has no other events to dispatch
+ */
+static VALUE Coolio_IdleWatcher_on_idle(VALUE self)
+{
+  return Qnil;
+}
+
+/* libev callback */
+static void Coolio_IdleWatcher_libev_callback(struct ev_loop *ev_loop, struct ev_idle *idle, int revents)
+{
+  Coolio_Loop_process_event((VALUE)idle->data, revents);
+}
+
+/* Coolio::Loop dispatch callback */
+static void Coolio_IdleWatcher_dispatch_callback(VALUE self, int revents)
+{
+  if(revents & EV_IDLE)
+    rb_funcall(self, rb_intern("on_idle"), 0);
+  else
+    rb_raise(rb_eRuntimeError, "unknown revents value for ev_idle: %d", revents);
+}
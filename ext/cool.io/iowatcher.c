@@ -11,6 +11,11 @@
 #include "rubyio.h"
 #endif
 
+#ifndef _MSC_VER
+#include <unistd.h>
+#endif
+#include <errno.h>
+
 #include "ev_wrap.h"
 
 #include "cool.io.h"
@@ -20,14 +25,35 @@ static VALUE mCoolio = Qnil;
 static VALUE cCoolio_Watcher = Qnil;
 static VALUE cCoolio_Loop = Qnil;
 static VALUE cCoolio_IOWatcher = Qnil;
+static VALUE cSocketError = Qnil;
+
+static VALUE Coolio_IOWatcher_allocate(VALUE klass);
+static void Coolio_IOWatcher_mark(void *data);
+static size_t Coolio_IOWatcher_memsize(const void *data);
 
 static VALUE Coolio_IOWatcher_initialize(int argc, VALUE *argv, VALUE self);
 static VALUE Coolio_IOWatcher_attach(VALUE self, VALUE loop);
 static VALUE Coolio_IOWatcher_detach(VALUE self);
 static VALUE Coolio_IOWatcher_enable(VALUE self);
 static VALUE Coolio_IOWatcher_disable(VALUE self);
+static VALUE Coolio_IOWatcher_get_events(VALUE self);
+static VALUE Coolio_IOWatcher_set_events(VALUE self, VALUE flags);
 static VALUE Coolio_IOWatcher_on_readable(VALUE self);
 static VALUE Coolio_IOWatcher_on_writable(VALUE self);
+static VALUE Coolio_IOWatcher_set_read_target(VALUE self, VALUE target);
+static VALUE Coolio_IOWatcher_set_read_buffer(VALUE self, VALUE buffer);
+static VALUE Coolio_IOWatcher_get_inactivity_timeout(VALUE self);
+static VALUE Coolio_IOWatcher_set_inactivity_timeout(VALUE self, VALUE timeout);
+static VALUE Coolio_IOWatcher_on_inactivity_timeout(VALUE self);
+static VALUE Coolio_IOWatcher_touch(VALUE self);
+
+static int Coolio_IOWatcher_parse_events(VALUE flags);
+static void Coolio_IOWatcher_read(struct Coolio_Watcher *watcher_data);
+static VALUE Coolio_IOWatcher_read_deliver(VALUE args);
+static VALUE Coolio_IOWatcher_read_failed(VALUE target, VALUE exception);
+static void Coolio_IOWatcher_start_inactivity_timer(struct Coolio_Watcher *watcher_data);
+static void Coolio_IOWatcher_stop_inactivity_timer(struct Coolio_Watcher *watcher_data);
+static void Coolio_IOWatcher_inactivity_callback(struct ev_loop *ev_loop, struct ev_timer *timer, int revents);
 
 static void Coolio_IOWatcher_libev_callback(struct ev_loop *ev_loop, struct ev_io *io, int revents);
 static void Coolio_IOWatcher_dispatch_callback(VALUE self, int revents);
@@ -42,6 +68,7 @@ void Init_coolio_iowatcher()
   mCoolio = rb_define_module("Coolio");
   cCoolio_Watcher = rb_define_class_under(mCoolio, "Watcher", rb_cObject);
   cCoolio_IOWatcher = rb_define_class_under(mCoolio, "IOWatcher", cCoolio_Watcher);
+  rb_define_alloc_func(cCoolio_IOWatcher, Coolio_IOWatcher_allocate);
   cCoolio_Loop = rb_define_class_under(mCoolio, "Loop", rb_cObject);
 
   rb_define_method(cCoolio_IOWatcher, "initialize", Coolio_IOWatcher_initialize, -1);
@@ -49,45 +76,98 @@ void Init_coolio_iowatcher()
   rb_define_method(cCoolio_IOWatcher, "detach", Coolio_IOWatcher_detach, 0);
   rb_define_method(cCoolio_IOWatcher, "enable", Coolio_IOWatcher_enable, 0);
   rb_define_method(cCoolio_IOWatcher, "disable", Coolio_IOWatcher_disable, 0);
+  rb_define_method(cCoolio_IOWatcher, "events", Coolio_IOWatcher_get_events, 0);
+  rb_define_method(cCoolio_IOWatcher, "events=", Coolio_IOWatcher_set_events, 1);
   rb_define_method(cCoolio_IOWatcher, "on_readable", Coolio_IOWatcher_on_readable, 0);
   rb_define_method(cCoolio_IOWatcher, "on_writable", Coolio_IOWatcher_on_writable, 0);
+  rb_define_private_method(cCoolio_IOWatcher, "read_target=", Coolio_IOWatcher_set_read_target, 1);
+  rb_define_private_method(cCoolio_IOWatcher, "read_buffer=", Coolio_IOWatcher_set_read_buffer, 1);
+  rb_define_method(cCoolio_IOWatcher, "inactivity_timeout", Coolio_IOWatcher_get_inactivity_timeout, 0);
+  rb_define_method(cCoolio_IOWatcher, "inactivity_timeout=", Coolio_IOWatcher_set_inactivity_timeout, 1);
+  rb_define_method(cCoolio_IOWatcher, "on_inactivity_timeout", Coolio_IOWatcher_on_inactivity_timeout, 0);
+  rb_define_method(cCoolio_IOWatcher, "touch", Coolio_IOWatcher_touch, 0);
+}
+
+static const rb_data_type_t Coolio_IOWatcher_type = {
+  "Coolio::IOWatcher",
+  {
+    Coolio_IOWatcher_mark,
+    RUBY_DEFAULT_FREE,
+    Coolio_IOWatcher_memsize,
+  },
+  &Coolio_Watcher_type,
+};
+
+static VALUE Coolio_IOWatcher_allocate(VALUE klass)
+{
+  struct Coolio_Watcher_io *watcher_data;
+  VALUE watcher = TypedData_Make_Struct(klass, struct Coolio_Watcher_io, &Coolio_IOWatcher_type, watcher_data);
+
+  Coolio_Watcher_setup(watcher, &watcher_data->watcher);
+  watcher_data->read_target = Qnil;
+  watcher_data->read_buffer = Qnil;
+
+  return watcher;
+}
+
+static void Coolio_IOWatcher_mark(void *data)
+{
+  struct Coolio_Watcher_io *watcher_data = data;
+
+  Coolio_Watcher_mark(data);
+  rb_gc_mark(watcher_data->read_target);
+  rb_gc_mark(watcher_data->read_buffer);
+}
+
+static size_t Coolio_IOWatcher_memsize(const void *data)
+{
+  return sizeof(struct Coolio_Watcher_io);
+}
+
+/* Convert an 'r', 'w', or 'rw' event type into libev event flags */
+static int Coolio_IOWatcher_parse_events(VALUE flags)
+{
+  char *flags_str;
+
+  if(flags != Qnil)
+    flags_str = RSTRING_PTR(rb_String(flags));
+  else
+    flags_str = "r";
+
+  if(!strcmp(flags_str, "r"))
+    return EV_READ;
+  else if(!strcmp(flags_str, "w"))
+    return EV_WRITE;
+  else if(!strcmp(flags_str, "rw"))
+    return EV_READ | EV_WRITE;
+
+  rb_raise(rb_eArgError, "invalid event type: '%s' (must be 'r', 'w', or 'rw')", flags_str);
 }
 
 /**
  *  call-seq:
  *    Coolio::IOWatcher.initialize(IO, events = 'r') -> Coolio::IOWatcher
  * 
- * Create a new Coolio::IOWatcher for the given IO object and add it to the given Coolio::Loop
+ * Create a new Coolio::IOWatcher for the given IO object and add it to the given Coolio::Loop.
+ * A watcher for 'rw' fires on_readable and on_writable for the same event
+ * when the IO object is both readable and writable.
  */
 static VALUE Coolio_IOWatcher_initialize(int argc, VALUE *argv, VALUE self)
 {
   VALUE io, flags;
-  char *flags_str;
   int events;
   struct Coolio_Watcher *watcher_data;
 
   rb_scan_args(argc, argv, "11", &io, &flags);
 
-  if(flags != Qnil)
-    flags_str = RSTRING_PTR(rb_String(flags));
-  else
-    flags_str = "r";
-
-  if(!strcmp(flags_str, "r"))
-    events = EV_READ;
-  else if(!strcmp(flags_str, "w"))
-    events = EV_WRITE;
-  else if(!strcmp(flags_str, "rw"))
-    events = EV_READ | EV_WRITE;
-  else
-    rb_raise(rb_eArgError, "invalid event type: '%s' (must be 'r', 'w', or 'rw')", flags_str);
+  events = Coolio_IOWatcher_parse_events(flags);
 
   watcher_data = Coolio_Watcher_ptr(self);
   io = rb_convert_type(io, T_FILE, "IO", "to_io");
 
   watcher_data->dispatch_callback = Coolio_IOWatcher_dispatch_callback;
 #ifdef HAVE_RB_IO_DESCRIPTOR
-  ev_io_init(&watcher_data->event_types.ev_io, Coolio_IOWatcher_libev_callback, rb_io_descriptor(io), events);
+  ev_io_init(Coolio_Watcher_ev(watcher_data, io), Coolio_IOWatcher_libev_callback, rb_io_descriptor(io), events);
 #else
 #if defined(HAVE_RB_IO_T)
   rb_io_t *fptr;
@@ -95,9 +175,12 @@ static VALUE Coolio_IOWatcher_initialize(int argc, VALUE *argv, VALUE self)
   OpenFile *fptr;
 #endif
   GetOpenFile(io, fptr);
-  ev_io_init(&watcher_data->event_types.ev_io, Coolio_IOWatcher_libev_callback, FPTR_TO_FD(fptr), events);
+  ev_io_init(Coolio_Watcher_ev(watcher_data, io), Coolio_IOWatcher_libev_callback, FPTR_TO_FD(fptr), events);
 #endif
-  watcher_data->event_types.ev_io.data = (void *)self;
+  Coolio_Watcher_ev(watcher_data, io)->data = (void *)self;
+
+  ev_init(&((struct Coolio_Watcher_io *)watcher_data)->inactivity_timer, Coolio_IOWatcher_inactivity_callback);
+  ((struct Coolio_Watcher_io *)watcher_data)->inactivity_timer.data = (void *)self;
 
   return Qnil;
 }
@@ -112,6 +195,7 @@ static VALUE Coolio_IOWatcher_initialize(int argc, VALUE *argv, VALUE self)
 static VALUE Coolio_IOWatcher_attach(VALUE self, VALUE loop)
 {
   Watcher_Attach(io, Coolio_IOWatcher_detach, self, loop);
+  Coolio_IOWatcher_start_inactivity_timer(watcher_data);
 
   return self;  
 }
@@ -139,6 +223,7 @@ static VALUE Coolio_IOWatcher_detach(VALUE self)
 static VALUE Coolio_IOWatcher_enable(VALUE self)
 {
   Watcher_Enable(io, self);
+  Coolio_IOWatcher_start_inactivity_timer(watcher_data);
 
   return self;  
 }
@@ -153,10 +238,63 @@ static VALUE Coolio_IOWatcher_enable(VALUE self)
 static VALUE Coolio_IOWatcher_disable(VALUE self)
 {
   Watcher_Disable(io, self);
+  Coolio_IOWatcher_stop_inactivity_timer(watcher_data);
 
   return self;
 }
 
+/**
+ *  call-seq:
+ *    Coolio::IOWatcher#events -> Symbol
+ *
+ * The events (:r, :w, or :rw) the IO watcher is currently interested in
+ */
+static VALUE Coolio_IOWatcher_get_events(VALUE self)
+{
+  struct Coolio_Watcher *watcher_data = Coolio_Watcher_ptr(self);
+  int events = Coolio_Watcher_ev(watcher_data, io)->events & (EV_READ | EV_WRITE);
+
+  if(events == (EV_READ | EV_WRITE))
+    return ID2SYM(rb_intern("rw"));
+
+  return ID2SYM(rb_intern(events == EV_WRITE ? "w" : "r"));
+}
+
+/**
+ *  call-seq:
+ *    Coolio::IOWatcher#events = 'rw' -> String
+ *
+ * Change the events ('r', 'w', or 'rw') the IO watcher is interested in.
+ * The change happens in place, so a single watcher can toggle its interest
+ * in writability on and off while staying attached to its loop.
+ */
+static VALUE Coolio_IOWatcher_set_events(VALUE self, VALUE flags)
+{
+  int events;
+  struct Coolio_Watcher *watcher_data;
+  struct Coolio_Loop *loop_data;
+  struct ev_io *ev_io;
+
+  events = Coolio_IOWatcher_parse_events(flags);
+  watcher_data = Coolio_Watcher_ptr(self);
+  ev_io = Coolio_Watcher_ev(watcher_data, io);
+
+  if((ev_io->events & (EV_READ | EV_WRITE)) == events)
+    return flags;
+
+  /* libev requires an active ev_io to be stopped while it is modified */
+  if(watcher_data->loop != Qnil && watcher_data->enabled) {
+    loop_data = Coolio_Loop_ptr(watcher_data->loop);
+
+    ev_io_stop(loop_data->ev_loop, ev_io);
+    ev_io_set(ev_io, ev_io->fd, events);
+    ev_io_start(loop_data->ev_loop, ev_io);
+  } else
+    ev_io_set(ev_io, ev_io->fd, events);
+
+  return flags;
+}
+
 /**
  *  call-seq:
  *    Coolio::IOWatcher#on_readable -> nil
@@ -180,6 +318,156 @@ static VALUE Coolio_IOWatcher_on_writable(VALUE self)
   return Qnil;
 }
 
+/**
+ *  call-seq:
+ *    Coolio::IOWatcher#read_target = coolio_io -> Coolio::IO
+ *
+ * Read from the IO object natively whenever it becomes readable and pass
+ * the data to the given object's on_read instead of calling on_readable.
+ * End of file and read errors close the object instead of raising, and
+ * spurious wakeups are ignored.  Only usable for IO objects whose data is
+ * read directly from their file descriptor.
+ */
+static VALUE Coolio_IOWatcher_set_read_target(VALUE self, VALUE target)
+{
+  struct Coolio_Watcher *watcher_data = Coolio_Watcher_ptr(self);
+
+  ((struct Coolio_Watcher_io *)watcher_data)->read_target = target;
+
+  return target;
+}
+
+/**
+ *  call-seq:
+ *    Coolio::IOWatcher#read_buffer = string -> String
+ *
+ * Receive natively read data into the given String, handing the same
+ * String to on_read each time rather than a new one per read.  Without
+ * one the loop's read buffer is used if it has one.
+ */
+static VALUE Coolio_IOWatcher_set_read_buffer(VALUE self, VALUE buffer)
+{
+  struct Coolio_Watcher *watcher_data = Coolio_Watcher_ptr(self);
+
+  if(buffer != Qnil)
+    StringValue(buffer);
+
+  ((struct Coolio_Watcher_io *)watcher_data)->read_buffer = buffer;
+
+  return buffer;
+}
+
+/**
+ *  call-seq:
+ *    Coolio::IOWatcher#inactivity_timeout -> Float or nil
+ *
+ * Seconds without reads or writes after which on_inactivity_timeout is
+ * called, or nil if there's no such timeout
+ */
+static VALUE Coolio_IOWatcher_get_inactivity_timeout(VALUE self)
+{
+  struct Coolio_Watcher_io *io_data = (struct Coolio_Watcher_io *)Coolio_Watcher_ptr(self);
+
+  return io_data->inactivity_timeout > 0 ? rb_float_new(io_data->inactivity_timeout) : Qnil;
+}
+
+/**
+ *  call-seq:
+ *    Coolio::IOWatcher#inactivity_timeout = seconds -> Numeric
+ *
+ * Call on_inactivity_timeout whenever the given number of seconds pass
+ * without the watcher dispatching a read or write, counting from now.
+ * The deadline is pushed back by each dispatch without any bookkeeping
+ * beyond recording the loop's time.  nil or 0 remove the timeout.  It
+ * only runs while the watcher is enabled.
+ */
+static VALUE Coolio_IOWatcher_set_inactivity_timeout(VALUE self, VALUE timeout)
+{
+  struct Coolio_Watcher *watcher_data = Coolio_Watcher_ptr(self);
+  ev_tstamp seconds = timeout == Qnil ? 0 : NUM2DBL(timeout);
+
+  if(seconds < 0)
+    rb_raise(rb_eArgError, "inactivity timeout must not be negative");
+
+  Coolio_IOWatcher_stop_inactivity_timer(watcher_data);
+  ((struct Coolio_Watcher_io *)watcher_data)->inactivity_timeout = seconds;
+  Coolio_IOWatcher_start_inactivity_timer(watcher_data);
+
+  return timeout;
+}
+
+/**
+ *  call-seq:
+ *    Coolio::IOWatcher#on_inactivity_timeout -> nil
+ *
+ * Called when the inactivity timeout has passed without reads or writes.
+ * Unless the watcher is disabled, it's called again each time another
+ * inactivity timeout passes.
+ */
+static VALUE Coolio_IOWatcher_on_inactivity_timeout(VALUE self)
+{
+  return Qnil;
+}
+
+/**
+ *  call-seq:
+ *    Coolio::IOWatcher#touch -> Coolio::IOWatcher
+ *
+ * Count activity the watcher didn't dispatch itself, such as a write
+ * which completed without waiting for writability, as of the loop's time.
+ */
+static VALUE Coolio_IOWatcher_touch(VALUE self)
+{
+  struct Coolio_Watcher *watcher_data = Coolio_Watcher_ptr(self);
+
+  if(watcher_data->loop != Qnil)
+    ((struct Coolio_Watcher_io *)watcher_data)->last_activity = ev_now(Coolio_Loop_ptr(watcher_data->loop)->ev_loop);
+
+  return self;
+}
+
+/* Count the inactivity timeout from now, if there is one */
+static void Coolio_IOWatcher_start_inactivity_timer(struct Coolio_Watcher *watcher_data)
+{
+  struct Coolio_Watcher_io *io_data = (struct Coolio_Watcher_io *)watcher_data;
+  struct ev_loop *ev_loop;
+
+  if(io_data->inactivity_timeout <= 0 || watcher_data->loop == Qnil || !watcher_data->enabled)
+    return;
+
+  ev_loop = Coolio_Loop_ptr(watcher_data->loop)->ev_loop;
+  io_data->last_activity = ev_now(ev_loop);
+  io_data->inactivity_timer.repeat = io_data->inactivity_timeout;
+  ev_timer_again(ev_loop, &io_data->inactivity_timer);
+}
+
+static void Coolio_IOWatcher_stop_inactivity_timer(struct Coolio_Watcher *watcher_data)
+{
+  struct Coolio_Watcher_io *io_data = (struct Coolio_Watcher_io *)watcher_data;
+
+  if(ev_is_active(&io_data->inactivity_timer) || ev_is_pending(&io_data->inactivity_timer))
+    ev_timer_stop(Coolio_Loop_ptr(watcher_data->loop)->ev_loop, &io_data->inactivity_timer);
+}
+
+/* libev callback for the inactivity timer.  Rather than restarting the
+ * timer on every read and write, let it run out and then only start it
+ * again for whatever time remains since the last one. */
+static void Coolio_IOWatcher_inactivity_callback(struct ev_loop *ev_loop, struct ev_timer *timer, int revents)
+{
+  struct Coolio_Watcher_io *io_data = (struct Coolio_Watcher_io *)Coolio_Watcher_ptr((VALUE)timer->data);
+  ev_tstamp remaining = io_data->last_activity + io_data->inactivity_timeout - ev_now(ev_loop);
+
+  if(remaining > 0) {
+    timer->repeat = remaining;
+    ev_timer_again(ev_loop, timer);
+    return;
+  }
+
+  timer->repeat = io_data->inactivity_timeout;
+  ev_timer_again(ev_loop, timer);
+  Coolio_Loop_process_event((VALUE)timer->data, EV_TIMER);
+}
+
 /* libev callback */
 static void Coolio_IOWatcher_libev_callback(struct ev_loop *ev_loop, struct ev_io *io, int revents)
 {
@@ -189,10 +477,112 @@ static void Coolio_IOWatcher_libev_callback(struct ev_loop *ev_loop, struct ev_i
 /* Coolio::Loop dispatch callback */
 static void Coolio_IOWatcher_dispatch_callback(VALUE self, int revents)
 {   
-  if(revents & EV_READ)
-    rb_funcall(self, rb_intern("on_readable"), 0);
-  else if(revents & EV_WRITE)
-    rb_funcall(self, rb_intern("on_writable"), 0);
-  else
+  struct Coolio_Watcher *watcher_data;
+
+  if(!(revents & (EV_READ | EV_WRITE | EV_TIMER)))
     rb_raise(rb_eRuntimeError, "unknown revents value for ev_io: %d", revents);
+
+  watcher_data = Coolio_Watcher_ptr(self);
+
+  if(revents & EV_TIMER) {
+    /* A read or write in the same iteration means it wasn't idle after all */
+    if(!(revents & (EV_READ | EV_WRITE))) {
+      rb_funcall(self, rb_intern("on_inactivity_timeout"), 0);
+      return;
+    }
+  }
+
+  if(((struct Coolio_Watcher_io *)watcher_data)->inactivity_timeout > 0)
+    ((struct Coolio_Watcher_io *)watcher_data)->last_activity = ev_now(Coolio_Loop_ptr(watcher_data->loop)->ev_loop);
+
+  if(revents & EV_READ) {
+    if(((struct Coolio_Watcher_io *)watcher_data)->read_target != Qnil)
+      Coolio_IOWatcher_read(watcher_data);
+    else
+      rb_funcall(self, rb_intern("on_readable"), 0);
+
+    /* on_readable may have closed the IO or lost interest in writing */
+    if(!watcher_data->enabled || !(Coolio_Watcher_ev(watcher_data, io)->events & EV_WRITE))
+      return;
+  }
+
+  if(revents & EV_WRITE)
+    rb_funcall(self, rb_intern("on_writable"), 0);
+}
+
+/* Read whatever is available and hand it to the read target */
+static void Coolio_IOWatcher_read(struct Coolio_Watcher *watcher_data)
+{
+  struct Coolio_Loop *loop_data;
+  VALUE target, buffer, args[2];
+  char *dest;
+  ssize_t nbytes;
+
+  loop_data = Coolio_Loop_ptr(watcher_data->loop);
+  target = ((struct Coolio_Watcher_io *)watcher_data)->read_target;
+
+  buffer = ((struct Coolio_Watcher_io *)watcher_data)->read_buffer;
+  if(buffer == Qnil)
+    buffer = loop_data->read_buffer;
+
+  /* A reused String keeps its capacity between reads, so after the first
+   * read this neither allocates nor copies.  Callers which froze it get
+   * fresh Strings again. */
+  if(buffer != Qnil && !OBJ_FROZEN(buffer)) {
+    /* Copies the caller made of its contents must not see the next read */
+    rb_str_modify(buffer);
+    rb_str_resize(buffer, COOLIO_READBUF_SIZE);
+    dest = RSTRING_PTR(buffer);
+  } else {
+    buffer = Qnil;
+
+    /* Otherwise reads land in scratch space shared by the whole loop, so
+     * the String passed to on_read is only as large as what was received */
+    if(!loop_data->readbuf)
+      loop_data->readbuf = (char *)xmalloc(COOLIO_READBUF_SIZE);
+
+    dest = loop_data->readbuf;
+  }
+
+  nbytes = read(Coolio_Watcher_ev(watcher_data, io)->fd, dest, COOLIO_READBUF_SIZE);
+
+  if(buffer != Qnil)
+    rb_str_set_len(buffer, nbytes > 0 ? nbytes : 0);
+
+  if(nbytes < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+    return;
+
+  /* End of file, or an error such as ECONNRESET */
+  if(nbytes <= 0) {
+    rb_funcall(target, rb_intern("close"), 0);
+    return;
+  }
+
+  args[0] = target;
+  args[1] = buffer != Qnil ? buffer : rb_str_new(dest, nbytes);
+
+  /* socket is loaded by cool.io itself, but only after the extension */
+  if(cSocketError == Qnil)
+    cSocketError = rb_path2class("SocketError");
+
+  /* Like Coolio::IO#on_readable, I/O errors raised from on_read close the
+   * connection rather than propagating out of the loop */
+  rb_rescue2(
+      Coolio_IOWatcher_read_deliver, (VALUE)args,
+      Coolio_IOWatcher_read_failed, target,
+      rb_eSystemCallError, rb_eEOFError, rb_eIOError, cSocketError,
+      (VALUE)0
+  );
+}
+
+static VALUE Coolio_IOWatcher_read_deliver(VALUE args)
+{
+  VALUE *argv = (VALUE *)args;
+
+  return rb_funcall(argv[0], rb_intern("on_read"), 1, argv[1]);
+}
+
+static VALUE Coolio_IOWatcher_read_failed(VALUE target, VALUE exception)
+{
+  return rb_funcall(target, rb_intern("close"), 0);
 }
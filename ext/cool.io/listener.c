@@ -0,0 +1,153 @@
+/*
+ * Copyright (C) 2007-10 Tony Arcieri
+ * You may redistribute this under the terms of the Ruby license.
+ * See LICENSE for details
+ */
+
+#include "ruby.h"
+
+#ifndef _WIN32
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+#include <errno.h>
+
+#include "ev_wrap.h"
+
+#include "cool.io.h"
+
+static VALUE mCoolio = Qnil;
+static VALUE cCoolio_Watcher = Qnil;
+static VALUE cCoolio_IOWatcher = Qnil;
+static VALUE cCoolio_Listener = Qnil;
+
+static VALUE Coolio_Listener_accept_batch(VALUE self, VALUE budget, VALUE socket_class);
+
+#ifndef _WIN32
+static int Coolio_Listener_accept(int fd);
+static VALUE Coolio_Listener_wrap(VALUE data);
+static VALUE Coolio_Listener_close(VALUE socket);
+
+/* An accepted descriptor on its way into a Ruby socket */
+struct Coolio_Listener_accepted
+{
+  VALUE socket_class;
+  int fd;
+};
+#endif
+
+/*
+ * Coolio::Listener is defined in Ruby, this only provides its native
+ * accept loop
+ */
+void Init_coolio_listener()
+{
+  mCoolio = rb_define_module("Coolio");
+  cCoolio_Watcher = rb_define_class_under(mCoolio, "Watcher", rb_cObject);
+  cCoolio_IOWatcher = rb_define_class_under(mCoolio, "IOWatcher", cCoolio_Watcher);
+  cCoolio_Listener = rb_define_class_under(mCoolio, "Listener", cCoolio_IOWatcher);
+
+  rb_define_private_method(cCoolio_Listener, "accept_batch", Coolio_Listener_accept_batch, 2);
+}
+
+/**
+ *  call-seq:
+ *    Coolio::Listener#accept_batch(budget, socket_class) -> Array
+ *
+ * Accept up to budget pending connections on the watched socket without
+ * blocking, wrapping each in socket_class.for_fd.  Accepted sockets are
+ * non-blocking and close-on-exec.  Returns an empty array if no
+ * connection was pending, and only raises if accepting the first
+ * connection failed with something other than a transient error.
+ */
+static VALUE Coolio_Listener_accept_batch(VALUE self, VALUE budget, VALUE socket_class)
+{
+#ifdef _WIN32
+  rb_notimplement();
+  return Qnil;
+#else
+  struct Coolio_Watcher *watcher_data;
+  struct Coolio_Listener_accepted accepted;
+  VALUE sockets, socket;
+  int listen_fd, fd, max, error, state;
+  long i;
+
+  watcher_data = Coolio_Watcher_ptr(self);
+  listen_fd = Coolio_Watcher_ev(watcher_data, io)->fd;
+  max = NUM2INT(budget);
+  sockets = rb_ary_new();
+
+  while(RARRAY_LEN(sockets) < max) {
+    fd = Coolio_Listener_accept(listen_fd);
+
+    if(fd < 0) {
+      error = errno;
+
+      /* Connections aborted before we got to them are simply skipped */
+      if(error == ECONNABORTED || error == EPROTO || error == EINTR)
+        continue;
+
+      /* The backlog is drained, or another process took the connection */
+      if(error == EAGAIN || error == EWOULDBLOCK)
+        break;
+
+      /* Hand over what was accepted so far, the error recurs next time */
+      if(RARRAY_LEN(sockets) > 0)
+        break;
+
+      errno = error;
+      rb_sys_fail("accept");
+    }
+
+    accepted.socket_class = socket_class;
+    accepted.fd = fd;
+    socket = rb_protect(Coolio_Listener_wrap, (VALUE)&accepted, &state);
+
+    /* Nothing owns the descriptor, or the batch, if wrapping it failed */
+    if(state) {
+      close(fd);
+      for(i = 0; i < RARRAY_LEN(sockets); i++)
+        rb_protect(Coolio_Listener_close, RARRAY_AREF(sockets, i), 0);
+
+      rb_jump_tag(state);
+    }
+
+    rb_ary_push(sockets, socket);
+  }
+
+  return sockets;
+#endif
+}
+
+#ifndef _WIN32
+static VALUE Coolio_Listener_wrap(VALUE data)
+{
+  struct Coolio_Listener_accepted *accepted = (struct Coolio_Listener_accepted *)data;
+
+  return rb_funcall(accepted->socket_class, rb_intern("for_fd"), 1, INT2NUM(accepted->fd));
+}
+
+static VALUE Coolio_Listener_close(VALUE socket)
+{
+  return rb_funcall(socket, rb_intern("close"), 0);
+}
+
+/* Accept a connection as a non-blocking, close-on-exec descriptor */
+static int Coolio_Listener_accept(int fd)
+{
+#if defined(HAVE_ACCEPT4) && defined(SOCK_NONBLOCK) && defined(SOCK_CLOEXEC)
+  return accept4(fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+#else
+  int client = accept(fd, NULL, NULL);
+
+  if(client >= 0) {
+    fcntl(client, F_SETFL, fcntl(client, F_GETFL) | O_NONBLOCK);
+    fcntl(client, F_SETFD, FD_CLOEXEC);
+  }
+
+  return client;
+#endif
+}
+#endif
@@ -5,7 +5,12 @@
  */
 
 #include <assert.h>
+#include <string.h>
+#include <time.h>
 #include "ruby.h"
+#ifdef HAVE_RUBY_ATOMIC_H
+#include "ruby/atomic.h"
+#endif
 #include "ev_wrap.h"
 
 #include "cool.io.h"
@@ -14,20 +19,64 @@ static VALUE mCoolio = Qnil;
 static VALUE cCoolio_Loop = Qnil;
 
 static VALUE Coolio_Loop_allocate(VALUE klass);
+static void Coolio_Loop_mark(void *data);
 static void Coolio_Loop_free(void *data);
 
 static VALUE Coolio_Loop_ev_loop_new(VALUE self, VALUE flags);
+static VALUE Coolio_Loop_run(int argc, VALUE *argv, VALUE self);
 static VALUE Coolio_Loop_run_once(int argc, VALUE *argv, VALUE self);
 static VALUE Coolio_Loop_run_nonblock(VALUE self);
+static VALUE Coolio_Loop_stop(VALUE self);
+static VALUE Coolio_Loop_watchers(VALUE self);
+static VALUE Coolio_Loop_has_active_watchers(VALUE self);
+static VALUE Coolio_Loop_get_read_buffer(VALUE self);
+static VALUE Coolio_Loop_post(VALUE self);
+static VALUE Coolio_Loop_pending_posts(VALUE self);
+static VALUE Coolio_Loop_set_read_buffer(VALUE self, VALUE buffer);
+static VALUE Coolio_Loop_get_io_collect_interval(VALUE self);
+static VALUE Coolio_Loop_set_io_collect_interval(VALUE self, VALUE interval);
+static VALUE Coolio_Loop_get_timeout_collect_interval(VALUE self);
+static VALUE Coolio_Loop_set_timeout_collect_interval(VALUE self, VALUE interval);
+static ev_tstamp Coolio_Loop_collect_interval(VALUE interval);
+static VALUE Coolio_Loop_stats(VALUE self);
+
+static VALUE Coolio_Loop_run_iterations(VALUE self);
+static int Coolio_Loop_run_events(struct Coolio_Loop *loop_data, int flags);
+static VALUE Coolio_Loop_run_ensure(VALUE self);
+static void Coolio_Loop_set_timeout(struct Coolio_Loop *loop_data, VALUE timeout);
 
 static void Coolio_Loop_timeout_callback(struct ev_loop *ev_loop, struct ev_timer *timer, int revents);
 static void Coolio_Loop_dispatch_events(struct Coolio_Loop *loop_data);
+static void Coolio_Loop_post_callback(struct ev_loop *ev_loop, struct ev_async *async, int revents);
+static VALUE Coolio_Loop_call_posted(VALUE block);
+static void Coolio_Loop_run_posted(struct Coolio_Loop *loop_data);
+static void Coolio_Loop_poll_release(struct ev_loop *ev_loop);
+static void Coolio_Loop_poll_acquire(struct ev_loop *ev_loop);
+
+/* Posting only needs atomics to be safe for producers not holding the GVL */
+#ifdef HAVE_RUBY_ATOMIC_H
+#define POSTED_CAS(var, oldval, newval) RUBY_ATOMIC_PTR_CAS(var, oldval, newval)
+#define POSTED_TAKE(var) RUBY_ATOMIC_PTR_EXCHANGE(var, 0)
+#define POSTED_INC(var) RUBY_ATOMIC_SIZE_INC(var)
+#define POSTED_DEC(var) RUBY_ATOMIC_SIZE_DEC(var)
+#else
+#define POSTED_CAS(var, oldval, newval) ((var) == (oldval) ? ((var) = (newval), (oldval)) : (var))
+#define POSTED_TAKE(var) Coolio_Loop_take_posted(&(var))
+#define POSTED_INC(var) ((var)++)
+#define POSTED_DEC(var) ((var)--)
+
+static struct Coolio_Post *Coolio_Loop_take_posted(struct Coolio_Post **posted)
+{
+  struct Coolio_Post *head = *posted;
+
+  *posted = 0;
+  return head;
+}
+#endif
 
 #define DEFAULT_EVENTBUF_SIZE 32
 #define RUN_LOOP(loop_data, options) \
-  loop_data->running = 1; \
-  ev_loop(loop_data->ev_loop, options); \
-  loop_data->running = 0;
+  ev_loop(loop_data->ev_loop, options)
 
 /* 
  * Coolio::Loop represents an event loop.  Event watchers can be attached and
@@ -42,14 +91,27 @@ void Init_coolio_loop()
   rb_define_alloc_func(cCoolio_Loop, Coolio_Loop_allocate);
 
   rb_define_private_method(cCoolio_Loop, "ev_loop_new", Coolio_Loop_ev_loop_new, 1);
+  rb_define_method(cCoolio_Loop, "run", Coolio_Loop_run, -1);
   rb_define_method(cCoolio_Loop, "run_once", Coolio_Loop_run_once, -1);
   rb_define_method(cCoolio_Loop, "run_nonblock", Coolio_Loop_run_nonblock, 0);
+  rb_define_method(cCoolio_Loop, "stop", Coolio_Loop_stop, 0);
+  rb_define_method(cCoolio_Loop, "watchers", Coolio_Loop_watchers, 0);
+  rb_define_method(cCoolio_Loop, "has_active_watchers?", Coolio_Loop_has_active_watchers, 0);
+  rb_define_method(cCoolio_Loop, "read_buffer", Coolio_Loop_get_read_buffer, 0);
+  rb_define_private_method(cCoolio_Loop, "read_buffer=", Coolio_Loop_set_read_buffer, 1);
+  rb_define_method(cCoolio_Loop, "post", Coolio_Loop_post, 0);
+  rb_define_method(cCoolio_Loop, "pending_posts", Coolio_Loop_pending_posts, 0);
+  rb_define_method(cCoolio_Loop, "io_collect_interval", Coolio_Loop_get_io_collect_interval, 0);
+  rb_define_method(cCoolio_Loop, "io_collect_interval=", Coolio_Loop_set_io_collect_interval, 1);
+  rb_define_method(cCoolio_Loop, "timeout_collect_interval", Coolio_Loop_get_timeout_collect_interval, 0);
+  rb_define_method(cCoolio_Loop, "timeout_collect_interval=", Coolio_Loop_set_timeout_collect_interval, 1);
+  rb_define_method(cCoolio_Loop, "stats", Coolio_Loop_stats, 0);
 }
 
 static const rb_data_type_t Coolio_Loop_type = {
   "Coolio::Loop",
   {
-    NULL,
+    Coolio_Loop_mark,
     Coolio_Loop_free,
   },
 };
@@ -73,20 +135,60 @@ static VALUE Coolio_Loop_allocate(VALUE klass)
   loop->events_received = 0;
   loop->eventbuf_size = DEFAULT_EVENTBUF_SIZE;
   loop->eventbuf = (struct Coolio_Event *)xmalloc(sizeof(struct Coolio_Event) * DEFAULT_EVENTBUF_SIZE);
+  loop->watchers_head = 0;
+  loop->watcher_count = 0;
+  loop->active_watchers = 0;
+  loop->readbuf = 0;
+  loop->read_buffer = Qnil;
+  loop->posted = 0;
+  loop->posted_run = 0;
+  loop->posted_count = 0;
+  ev_async_init(&loop->post_async, Coolio_Loop_post_callback);
+  loop->io_collect_interval = 0;
+  loop->timeout_collect_interval = 0;
+  memset(&loop->stats, 0, sizeof(loop->stats));
 
   return obj;
 }
 
+/* Attached watchers are kept alive by the loop they're attached to */
+static void Coolio_Loop_mark(void *data)
+{
+  struct Coolio_Loop *loop = data;
+  struct Coolio_Watcher *watcher_data;
+  struct Coolio_Post *post;
+
+  for(watcher_data = loop->watchers_head; watcher_data; watcher_data = watcher_data->next)
+    rb_gc_mark(watcher_data->self);
+
+  rb_gc_mark(loop->read_buffer);
+
+  for(post = loop->posted; post; post = post->next)
+    rb_gc_mark(post->block);
+  for(post = loop->posted_run; post; post = post->next)
+    rb_gc_mark(post->block);
+}
+
 static void Coolio_Loop_free(void *data)
 {
   struct Coolio_Loop *loop = data;
+  struct Coolio_Post *post;
 
-  if(!loop->ev_loop)
-    return;
+  if(loop->ev_loop)
+    ev_loop_destroy(loop->ev_loop);
 
-  ev_loop_destroy(loop->ev_loop);
+  while((post = loop->posted)) {
+    loop->posted = post->next;
+    xfree(post);
+  }
+  while((post = loop->posted_run)) {
+    loop->posted_run = post->next;
+    xfree(post);
+  }
 
   xfree(loop->eventbuf);
+  if(loop->readbuf)
+    xfree(loop->readbuf);
   xfree(loop);
 }
 
@@ -100,6 +202,18 @@ static VALUE Coolio_Loop_ev_loop_new(VALUE self, VALUE flags)
     rb_raise(rb_eRuntimeError, "loop already initialized");
 
   loop_data->ev_loop = ev_loop_new(NUM2INT(flags));
+  ev_set_io_collect_interval(loop_data->ev_loop, loop_data->io_collect_interval);
+  ev_set_timeout_collect_interval(loop_data->ev_loop, loop_data->timeout_collect_interval);
+
+  /* The backends call these right around their system call, and our libev
+   * patch around the collect interval sleep, which lets us time how long
+   * the loop spends blocked */
+  ev_set_userdata(loop_data->ev_loop, loop_data);
+  ev_set_loop_release_cb(loop_data->ev_loop, Coolio_Loop_poll_release, Coolio_Loop_poll_acquire);
+
+  /* Posted blocks wake the loop up, but don't keep it running */
+  ev_async_start(loop_data->ev_loop, &loop_data->post_async);
+  ev_unref(loop_data->ev_loop);
 
   return Qnil;
 }
@@ -109,6 +223,7 @@ void Coolio_Loop_process_event(VALUE watcher, int revents)
 {
   struct Coolio_Loop *loop_data;
   struct Coolio_Watcher *watcher_data;
+  int i;
 
   /* The Global VM lock isn't held right now, but hopefully
    * we can still do this safely */
@@ -164,6 +279,15 @@ void Coolio_Loop_process_event(VALUE watcher, int revents)
    *  function below will also return, at which point the GVL is
    *  reacquired and we can call out to Ruby */
 
+  /* libev only invokes a watcher once per iteration, but should an event
+   * for this watcher already be pending, fold the new one into it so
+   * that each watcher owns at most one slot in the event buffer */
+  i = watcher_data->pending_index;
+  if(i >= 0 && i < loop_data->events_received && loop_data->eventbuf[i].watcher == watcher) {
+    loop_data->eventbuf[i].revents |= revents;
+    return;
+  }
+
   /* Grow the event buffer if it's too small */
   if(loop_data->events_received >= loop_data->eventbuf_size) {
     loop_data->eventbuf_size *= 2;
@@ -175,6 +299,7 @@ void Coolio_Loop_process_event(VALUE watcher, int revents)
 
   loop_data->eventbuf[loop_data->events_received].watcher = watcher;
   loop_data->eventbuf[loop_data->events_received].revents = revents;
+  watcher_data->pending_index = loop_data->events_received;
 
   loop_data->events_received++;
 }
@@ -186,6 +311,320 @@ static void Coolio_Loop_timeout_callback(struct ev_loop *ev_loop, struct ev_time
      timer is sufficient to interrupt the selector. However, libev still wants a callback */
 }
 
+/**
+ *  call-seq:
+ *    Coolio::Loop.run(timeout = nil) -> nil
+ *
+ * Run the event loop and dispatch events back to Ruby.  If there
+ * are no watchers associated with the event loop it will return
+ * immediately.  Otherwise, run will continue blocking and making
+ * event callbacks to watchers until all watchers associated with
+ * the loop have been disabled or detached.  The loop may be
+ * explicitly stopped by calling the stop method on the loop object.
+ *
+ * If a timeout is given, each iteration blocks for at most that many
+ * seconds waiting for events.
+ */
+static VALUE Coolio_Loop_run(int argc, VALUE *argv, VALUE self)
+{
+  VALUE timeout;
+  struct Coolio_Loop *loop_data;
+
+  rb_scan_args(argc, argv, "01", &timeout);
+
+  if (timeout != Qnil && NUM2DBL(timeout) < 0) {
+    rb_raise(rb_eArgError, "time interval must be positive");
+  }
+
+  loop_data = Coolio_Loop_ptr(self);
+
+  if(loop_data->watcher_count == 0)
+    rb_raise(rb_eRuntimeError, "no watchers for this loop");
+
+  assert(loop_data->ev_loop && !loop_data->events_received);
+
+  /* The timeout timer repeats on its own, so it only needs to be armed
+   * once for the whole run rather than once per iteration */
+  Coolio_Loop_set_timeout(loop_data, timeout);
+
+  loop_data->running = 1;
+  rb_ensure(Coolio_Loop_run_iterations, self, Coolio_Loop_run_ensure, self);
+
+  return Qnil;
+}
+
+/* Body of Coolio::Loop#run, iterates until stopped or out of active watchers */
+static VALUE Coolio_Loop_run_iterations(VALUE self)
+{
+  struct Coolio_Loop *loop_data = Coolio_Loop_ptr(self);
+
+  while(loop_data->running && loop_data->active_watchers > 0)
+    Coolio_Loop_run_events(loop_data, EVLOOP_ONESHOT);
+
+  return Qnil;
+}
+
+/* Always leave the loop in the stopped state, even if a callback raised */
+static VALUE Coolio_Loop_run_ensure(VALUE self)
+{
+  struct Coolio_Loop *loop_data = Coolio_Loop_ptr(self);
+
+  loop_data->running = 0;
+  ev_timer_stop(loop_data->ev_loop, &loop_data->timer);
+
+  return Qnil;
+}
+
+/**
+ *  call-seq:
+ *    Coolio::Loop.stop -> nil
+ *
+ * Stop the event loop if it's running.  The loop finishes dispatching
+ * the events of the current iteration and then returns from run.
+ */
+static VALUE Coolio_Loop_stop(VALUE self)
+{
+  struct Coolio_Loop *loop_data = Coolio_Loop_ptr(self);
+
+  if(!loop_data->running)
+    rb_raise(rb_eRuntimeError, "loop not running");
+
+  loop_data->running = 0;
+
+  return Qnil;
+}
+
+/**
+ *  call-seq:
+ *    Coolio::Loop.watchers -> Array
+ *
+ * All watchers attached to the current loop
+ */
+static VALUE Coolio_Loop_watchers(VALUE self)
+{
+  struct Coolio_Loop *loop_data = Coolio_Loop_ptr(self);
+  struct Coolio_Watcher *watcher_data;
+  VALUE watchers;
+  int i;
+
+  /* The registry is newest first, report watchers in attach order */
+  watchers = rb_ary_new2(loop_data->watcher_count);
+  i = loop_data->watcher_count;
+  for(watcher_data = loop_data->watchers_head; watcher_data; watcher_data = watcher_data->next)
+    rb_ary_store(watchers, --i, watcher_data->self);
+
+  return watchers;
+}
+
+/**
+ *  call-seq:
+ *    Coolio::Loop.has_active_watchers? -> Boolean
+ *
+ * Does the loop have any active watchers?
+ */
+static VALUE Coolio_Loop_has_active_watchers(VALUE self)
+{
+  return Coolio_Loop_ptr(self)->active_watchers > 0 ? Qtrue : Qfalse;
+}
+
+/**
+ *  call-seq:
+ *    Coolio::Loop.read_buffer -> String
+ *
+ * The String shared by all Coolio::IO objects on this loop to receive
+ * data, or nil unless the loop was created with :reuse_read_buffer
+ */
+static VALUE Coolio_Loop_get_read_buffer(VALUE self)
+{
+  return Coolio_Loop_ptr(self)->read_buffer;
+}
+
+static VALUE Coolio_Loop_set_read_buffer(VALUE self, VALUE buffer)
+{
+  if(buffer != Qnil)
+    StringValue(buffer);
+
+  Coolio_Loop_ptr(self)->read_buffer = buffer;
+
+  return buffer;
+}
+
+static ev_tstamp Coolio_Loop_collect_interval(VALUE interval)
+{
+  ev_tstamp seconds = interval == Qnil ? 0 : NUM2DBL(interval);
+
+  if(seconds < 0)
+    rb_raise(rb_eArgError, "collect interval must not be negative");
+
+  return seconds;
+}
+
+/**
+ *  call-seq:
+ *    Coolio::Loop#io_collect_interval -> Float
+ *
+ * Seconds the loop waits after a wakeup to collect more I/O events
+ */
+static VALUE Coolio_Loop_get_io_collect_interval(VALUE self)
+{
+  return rb_float_new(Coolio_Loop_ptr(self)->io_collect_interval);
+}
+
+/**
+ *  call-seq:
+ *    Coolio::Loop#io_collect_interval = seconds -> Numeric
+ *
+ * Have each iteration of the loop wait at least this long between polls
+ * for I/O, so that busy loops pick up more events per system call and
+ * dispatch them in larger batches, at the cost of adding up to this much
+ * latency to each event.  Something around 0.001 is a good start for
+ * loops handling many connections.  0 (the default) polls as soon as
+ * possible.  The loop sleeps without holding the GVL, just like it polls,
+ * so other threads keep running meanwhile.  See ev_set_io_collect_interval
+ * in libev's documentation.
+ */
+static VALUE Coolio_Loop_set_io_collect_interval(VALUE self, VALUE interval)
+{
+  struct Coolio_Loop *loop_data = Coolio_Loop_ptr(self);
+
+  loop_data->io_collect_interval = Coolio_Loop_collect_interval(interval);
+  if(loop_data->ev_loop)
+    ev_set_io_collect_interval(loop_data->ev_loop, loop_data->io_collect_interval);
+
+  return interval;
+}
+
+/**
+ *  call-seq:
+ *    Coolio::Loop#timeout_collect_interval -> Float
+ *
+ * Seconds the loop waits to let timers expire together
+ */
+static VALUE Coolio_Loop_get_timeout_collect_interval(VALUE self)
+{
+  return rb_float_new(Coolio_Loop_ptr(self)->timeout_collect_interval);
+}
+
+/**
+ *  call-seq:
+ *    Coolio::Loop#timeout_collect_interval = seconds -> Numeric
+ *
+ * Let timers fire up to this much late, so that timers expiring close
+ * together are dispatched in a single iteration rather than waking the
+ * loop up for each.  0 (the default) fires each timer on time.  See
+ * ev_set_timeout_collect_interval in libev's documentation.
+ */
+static VALUE Coolio_Loop_set_timeout_collect_interval(VALUE self, VALUE interval)
+{
+  struct Coolio_Loop *loop_data = Coolio_Loop_ptr(self);
+
+  loop_data->timeout_collect_interval = Coolio_Loop_collect_interval(interval);
+  if(loop_data->ev_loop)
+    ev_set_timeout_collect_interval(loop_data->ev_loop, loop_data->timeout_collect_interval);
+
+  return interval;
+}
+
+/**
+ *  call-seq:
+ *    Coolio::Loop#post { ... } -> Coolio::Loop
+ *
+ * Run the given block on the loop's thread during its next iteration,
+ * waking the loop up if it's waiting for events.  This may be called from
+ * any thread and never waits for the loop: blocks are queued without
+ * locking, and everything queued by the time the loop gets to them is run
+ * in one batch, in the order posted, after that iteration's events have
+ * been dispatched.  Posted blocks don't keep the loop running by
+ * themselves.
+ */
+static VALUE Coolio_Loop_post(VALUE self)
+{
+  struct Coolio_Loop *loop_data = Coolio_Loop_ptr(self);
+  struct Coolio_Post *post, *head;
+  VALUE block;
+
+  if(!loop_data->ev_loop)
+    rb_raise(rb_eRuntimeError, "loop not initialized");
+
+  /* Raises without a block, so get it before there's anything to leak */
+  block = rb_block_proc();
+
+  post = (struct Coolio_Post *)xmalloc(sizeof(struct Coolio_Post));
+  post->block = block;
+
+  do {
+    head = loop_data->posted;
+    post->next = head;
+  } while(POSTED_CAS(loop_data->posted, head, post) != head);
+
+  POSTED_INC(loop_data->posted_count);
+  ev_async_send(loop_data->ev_loop, &loop_data->post_async);
+
+  return self;
+}
+
+/**
+ *  call-seq:
+ *    Coolio::Loop#pending_posts -> Integer
+ *
+ * Number of posted blocks the loop hasn't run yet, for producers which
+ * need to apply backpressure
+ */
+static VALUE Coolio_Loop_pending_posts(VALUE self)
+{
+  return SIZET2NUM(Coolio_Loop_ptr(self)->posted_count);
+}
+
+/* The async watcher only exists to interrupt the selector */
+static void Coolio_Loop_post_callback(struct ev_loop *ev_loop, struct ev_async *async, int revents)
+{
+}
+
+static VALUE Coolio_Loop_call_posted(VALUE block)
+{
+  return rb_funcall(block, rb_intern("call"), 0);
+}
+
+/* Run every block posted so far */
+static void Coolio_Loop_run_posted(struct Coolio_Loop *loop_data)
+{
+  struct Coolio_Post *post, *batch, *ordered = 0, **tail;
+  VALUE block;
+  int state;
+
+  /* Take the whole queue at once and put it back in posting order, behind
+   * any blocks left over because an earlier one raised */
+  batch = POSTED_TAKE(loop_data->posted);
+
+  while(batch) {
+    post = batch;
+    batch = post->next;
+    post->next = ordered;
+    ordered = post;
+  }
+
+  for(tail = &loop_data->posted_run; *tail; tail = &(*tail)->next);
+  *tail = ordered;
+
+  while((post = loop_data->posted_run)) {
+    loop_data->posted_run = post->next;
+    block = post->block;
+    xfree(post);
+    POSTED_DEC(loop_data->posted_count);
+
+    rb_protect(Coolio_Loop_call_posted, block, &state);
+
+    if(state) {
+      /* The async watcher's wakeup was used up by this batch, so make sure
+       * the next iteration doesn't block with blocks still queued */
+      if(loop_data->posted_run)
+        ev_async_send(loop_data->ev_loop, &loop_data->post_async);
+
+      rb_jump_tag(state);
+    }
+  }
+}
+
 /**
  *  call-seq:
  *    Coolio::Loop.run_once -> nil
@@ -195,7 +634,6 @@ static void Coolio_Loop_timeout_callback(struct ev_loop *ev_loop, struct ev_time
 static VALUE Coolio_Loop_run_once(int argc, VALUE *argv, VALUE self)
 {
   VALUE timeout;
-  VALUE nevents;
   struct Coolio_Loop *loop_data;
 
   rb_scan_args(argc, argv, "01", &timeout);
@@ -208,7 +646,14 @@ static VALUE Coolio_Loop_run_once(int argc, VALUE *argv, VALUE self)
 
   assert(loop_data->ev_loop && !loop_data->events_received);
 
-  /* Implement the optional timeout (if any) as a ev_timer */
+  Coolio_Loop_set_timeout(loop_data, timeout);
+
+  return INT2NUM(Coolio_Loop_run_events(loop_data, EVLOOP_ONESHOT));
+}
+
+/* Implement the optional timeout (if any) as a ev_timer */
+static void Coolio_Loop_set_timeout(struct Coolio_Loop *loop_data, VALUE timeout)
+{
   /* Using the technique written at
      http://pod.tst.eu/http://cvs.schmorp.de/libev/ev.pod#code_ev_timer_code_relative_and_opti,
      the timer is not stopped/started everytime when timeout is specified, instead,
@@ -220,15 +665,6 @@ static VALUE Coolio_Loop_run_once(int argc, VALUE *argv, VALUE self)
   } else {
     ev_timer_stop(loop_data->ev_loop, &loop_data->timer);
   }
-
-  /* libev is patched to release the GIL when it makes its system call */
-  RUN_LOOP(loop_data, EVLOOP_ONESHOT);
-
-  Coolio_Loop_dispatch_events(loop_data);
-  nevents = INT2NUM(loop_data->events_received);
-  loop_data->events_received = 0;
-
-  return nevents;
 }
 
 /**
@@ -240,18 +676,39 @@ static VALUE Coolio_Loop_run_once(int argc, VALUE *argv, VALUE self)
 static VALUE Coolio_Loop_run_nonblock(VALUE self)
 {
   struct Coolio_Loop *loop_data;
-  VALUE nevents;
   
   loop_data = Coolio_Loop_ptr(self);
 
   assert(loop_data->ev_loop && !loop_data->events_received);
 
-  RUN_LOOP(loop_data, EVLOOP_NONBLOCK);  
+  return INT2NUM(Coolio_Loop_run_events(loop_data, EVLOOP_NONBLOCK));
+}
+
+/* Run one iteration of the libev loop and dispatch what it received,
+ * returning the number of events */
+static int Coolio_Loop_run_events(struct Coolio_Loop *loop_data, int flags)
+{
+  struct Coolio_Loop_stats *stats = &loop_data->stats;
+  int nevents, bucket;
+  double started;
+
+  /* libev is patched to release the GIL when it makes its system call */
+  RUN_LOOP(loop_data, flags);
+
+  nevents = loop_data->events_received;
+  for(bucket = 0; bucket < COOLIO_STATS_BUCKETS - 1 && (nevents >> bucket); bucket++);
+
+  stats->wakeups++;
+  stats->events_per_wakeup[bucket]++;
+  if(nevents > stats->eventbuf_high_water)
+    stats->eventbuf_high_water = nevents;
+
+  started = Coolio_Loop_clock();
   Coolio_Loop_dispatch_events(loop_data);
-  
-  nevents = INT2NUM(loop_data->events_received);
+  stats->dispatch_time += Coolio_Loop_clock() - started;
+
   loop_data->events_received = 0;
-  
+
   return nevents;
 }
 
@@ -268,6 +725,81 @@ static void Coolio_Loop_dispatch_events(struct Coolio_Loop *loop_data)
       continue;
 
     watcher_data = Coolio_Watcher_ptr(loop_data->eventbuf[i].watcher);
+    watcher_data->pending_index = -1;
+    loop_data->stats.events++;
     watcher_data->dispatch_callback(loop_data->eventbuf[i].watcher, loop_data->eventbuf[i].revents);
   }
+
+  if(loop_data->posted || loop_data->posted_run)
+    Coolio_Loop_run_posted(loop_data);
+}
+
+/* Called by the backend, without the GVL, right before it blocks, and
+ * around the io_collect_interval sleep before that */
+static void Coolio_Loop_poll_release(struct ev_loop *ev_loop)
+{
+  struct Coolio_Loop *loop_data = ev_userdata(ev_loop);
+
+  loop_data->stats.poll_started = Coolio_Loop_clock();
+}
+
+/* Called by the backend, without the GVL, as soon as it's done blocking */
+static void Coolio_Loop_poll_acquire(struct ev_loop *ev_loop)
+{
+  struct Coolio_Loop *loop_data = ev_userdata(ev_loop);
+
+  loop_data->stats.poll_time += Coolio_Loop_clock() - loop_data->stats.poll_started;
+}
+
+/* Seconds on a clock that doesn't jump around with the time of day */
+double Coolio_Loop_clock(void)
+{
+#ifdef CLOCK_MONOTONIC
+  struct timespec ts;
+
+  if(clock_gettime(CLOCK_MONOTONIC, &ts) == 0)
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+#endif
+
+  return ev_time();
+}
+
+/**
+ *  call-seq:
+ *    Coolio::Loop#stats -> Hash
+ *
+ * Counters kept since the loop was created, cheap enough to leave on:
+ *
+ * :iterations - iterations of the libev loop
+ * :wakeups - times the loop returned from libev to dispatch events
+ * :events - events dispatched to watchers
+ * :events_per_wakeup - histogram of the events received per wakeup, keyed
+ *   by the lower bound of each bucket (0, 1, 2, 4, 8, ...)
+ * :eventbuf_high_water - most events received in a single wakeup
+ * :poll_time - seconds spent blocked in the backend without the GVL,
+ *   including any io_collect_interval sleep
+ * :dispatch_time - seconds spent dispatching events to Ruby
+ */
+static VALUE Coolio_Loop_stats(VALUE self)
+{
+  struct Coolio_Loop *loop_data = Coolio_Loop_ptr(self);
+  struct Coolio_Loop_stats *stats = &loop_data->stats;
+  VALUE result = rb_hash_new(), histogram = rb_hash_new();
+  int bucket;
+
+  for(bucket = 0; bucket < COOLIO_STATS_BUCKETS; bucket++)
+    rb_hash_aset(histogram,
+        INT2NUM(bucket ? 1 << (bucket - 1) : 0),
+        ULONG2NUM(stats->events_per_wakeup[bucket]));
+
+  rb_hash_aset(result, ID2SYM(rb_intern("iterations")),
+      UINT2NUM(loop_data->ev_loop ? ev_iteration(loop_data->ev_loop) : 0));
+  rb_hash_aset(result, ID2SYM(rb_intern("wakeups")), ULONG2NUM(stats->wakeups));
+  rb_hash_aset(result, ID2SYM(rb_intern("events")), ULONG2NUM(stats->events));
+  rb_hash_aset(result, ID2SYM(rb_intern("events_per_wakeup")), histogram);
+  rb_hash_aset(result, ID2SYM(rb_intern("eventbuf_high_water")), INT2NUM(stats->eventbuf_high_water));
+  rb_hash_aset(result, ID2SYM(rb_intern("poll_time")), rb_float_new(stats->poll_time));
+  rb_hash_aset(result, ID2SYM(rb_intern("dispatch_time")), rb_float_new(stats->dispatch_time));
+
+  return result;
 }
@@ -0,0 +1,197 @@
+/*
+ * Copyright (C) 2007-10 Tony Arcieri
+ * You may redistribute this under the terms of the Ruby license.
+ * See LICENSE for details
+ */
+
+#include "ruby.h"
+#include "ev_wrap.h"
+
+#include "cool.io.h"
+#include "watcher.h"
+
+static VALUE mCoolio = Qnil;
+static VALUE cCoolio_Watcher = Qnil;
+static VALUE cCoolio_NativeAsyncWatcher = Qnil;
+static VALUE cCoolio_Loop = Qnil;
+
+static VALUE Coolio_NativeAsyncWatcher_allocate(VALUE klass);
+static size_t Coolio_NativeAsyncWatcher_memsize(const void *data);
+
+static VALUE Coolio_NativeAsyncWatcher_initialize(VALUE self);
+static VALUE Coolio_NativeAsyncWatcher_attach(VALUE self, VALUE loop);
+static VALUE Coolio_NativeAsyncWatcher_detach(VALUE self);
+static VALUE Coolio_NativeAsyncWatcher_enable(VALUE self);
+static VALUE Coolio_NativeAsyncWatcher_disable(VALUE self);
+static VALUE Coolio_NativeAsyncWatcher_signal(VALUE self);
+static VALUE Coolio_NativeAsyncWatcher_on_signal(VALUE self);
+
+static void Coolio_NativeAsyncWatcher_libev_callback(struct ev_loop *ev_loop, struct ev_async *async, int revents);
+static void Coolio_NativeAsyncWatcher_dispatch_callback(VALUE self, int revents);
+
+/*
+ * Coolio::NativeAsyncWatcher lets other threads wake up a Coolio::Loop.
+ * Unlike Coolio::AsyncWatcher it's built on libev's async watchers rather
+ * than a pipe, so it needs no file descriptors of its own (the loop wakes
+ * up through a single eventfd where available), and any number of
+ * signals sent before the loop gets around to them result in one call
+ * to on_signal.
+ */
+void Init_coolio_native_async_watcher()
+{
+  mCoolio = rb_define_module("Coolio");
+  cCoolio_Watcher = rb_define_class_under(mCoolio, "Watcher", rb_cObject);
+  cCoolio_NativeAsyncWatcher = rb_define_class_under(mCoolio, "NativeAsyncWatcher", cCoolio_Watcher);
+  rb_define_alloc_func(cCoolio_NativeAsyncWatcher, Coolio_NativeAsyncWatcher_allocate);
+  cCoolio_Loop = rb_define_class_under(mCoolio, "Loop", rb_cObject);
+
+  rb_define_method(cCoolio_NativeAsyncWatcher, "initialize", Coolio_NativeAsyncWatcher_initialize, 0);
+  rb_define_method(cCoolio_NativeAsyncWatcher, "attach", Coolio_NativeAsyncWatcher_attach, 1);
+  rb_define_method(cCoolio_NativeAsyncWatcher, "detach", Coolio_NativeAsyncWatcher_detach, 0);
+  rb_define_method(cCoolio_NativeAsyncWatcher, "enable", Coolio_NativeAsyncWatcher_enable, 0);
+  rb_define_method(cCoolio_NativeAsyncWatcher, "disable", Coolio_NativeAsyncWatcher_disable, 0);
+  rb_define_method(cCoolio_NativeAsyncWatcher, "signal", Coolio_NativeAsyncWatcher_signal, 0);
+  rb_define_method(cCoolio_NativeAsyncWatcher, "on_signal", Coolio_NativeAsyncWatcher_on_signal, 0);
+}
+
+static const rb_data_type_t Coolio_NativeAsyncWatcher_type = {
+  "Coolio::NativeAsyncWatcher",
+  {
+    Coolio_Watcher_mark,
+    RUBY_DEFAULT_FREE,
+    Coolio_NativeAsyncWatcher_memsize,
+  },
+  &Coolio_Watcher_type,
+};
+
+static VALUE Coolio_NativeAsyncWatcher_allocate(VALUE klass)
+{
+  struct Coolio_Watcher_async *watcher_data;
+  VALUE watcher = TypedData_Make_Struct(klass, struct Coolio_Watcher_async, &Coolio_NativeAsyncWatcher_type, watcher_data);
+
+  Coolio_Watcher_setup(watcher, &watcher_data->watcher);
+
+  return watcher;
+}
+
+static size_t Coolio_NativeAsyncWatcher_memsize(const void *data)
+{
+  return sizeof(struct Coolio_Watcher_async);
+}
+
+/**
+ *  call-seq:
+ *    Coolio::NativeAsyncWatcher.initialize -> Coolio::NativeAsyncWatcher
+ *
+ * Create a new Coolio::NativeAsyncWatcher
+ */
+static VALUE Coolio_NativeAsyncWatcher_initialize(VALUE self)
+{
+  struct Coolio_Watcher *watcher_data = Coolio_Watcher_ptr(self);
+
+  watcher_data->dispatch_callback = Coolio_NativeAsyncWatcher_dispatch_callback;
+  ev_async_init(Coolio_Watcher_ev(watcher_data, async), Coolio_NativeAsyncWatcher_libev_callback);
+  Coolio_Watcher_ev(watcher_data, async)->data = (void *)self;
+
+  return Qnil;
+}
+
+/**
+ *  call-seq:
+ *    Coolio::NativeAsyncWatcher.attach(loop) -> Coolio::NativeAsyncWatcher
+ *
+ * Attach the async watcher to the given Coolio::Loop.  If the watcher is already
+ * attached to a loop, detach it from the old one and attach it to the new one.
+ */
+static VALUE Coolio_NativeAsyncWatcher_attach(VALUE self, VALUE loop)
+{
+  Watcher_Attach(async, Coolio_NativeAsyncWatcher_detach, self, loop);
+
+  return self;
+}
+
+/**
+ *  call-seq:
+ *    Coolio::NativeAsyncWatcher.detach -> Coolio::NativeAsyncWatcher
+ *
+ * Detach the async watcher from its current Coolio::Loop.
+ */
+static VALUE Coolio_NativeAsyncWatcher_detach(VALUE self)
+{
+  Watcher_Detach(async, self);
+
+  return self;
+}
+
+/**
+ *  call-seq:
+ *    Coolio::NativeAsyncWatcher.enable -> Coolio::NativeAsyncWatcher
+ *
+ * Re-enable an async watcher which has been temporarily disabled.  See the
+ * disable method for a more thorough explanation.
+ */
+static VALUE Coolio_NativeAsyncWatcher_enable(VALUE self)
+{
+  Watcher_Enable(async, self);
+
+  return self;
+}
+
+/**
+ *  call-seq:
+ *    Coolio::NativeAsyncWatcher.disable -> Coolio::NativeAsyncWatcher
+ *
+ * Temporarily disable an async watcher which is attached to a loop.
+ * Signals sent while it is disabled are lost.
+ */
+static VALUE Coolio_NativeAsyncWatcher_disable(VALUE self)
+{
+  Watcher_Disable(async, self);
+
+  return self;
+}
+
+/**
+ *  call-seq:
+ *    Coolio::NativeAsyncWatcher#signal -> Coolio::NativeAsyncWatcher
+ *
+ * Wake up the loop the watcher is attached to and have it call on_signal.
+ * This may be called from any thread.  It never blocks, and signals which
+ * arrive before the loop has dispatched the previous one are coalesced.
+ */
+static VALUE Coolio_NativeAsyncWatcher_signal(VALUE self)
+{
+  struct Coolio_Watcher *watcher_data = Coolio_Watcher_ptr(self);
+
+  /* ev_async_send is thread and signal safe, and needs no Ruby state */
+  if(watcher_data->loop != Qnil && watcher_data->enabled)
+    ev_async_send(Coolio_Loop_ptr(watcher_data->loop)->ev_loop, Coolio_Watcher_ev(watcher_data, async));
+
+  return self;
+}
+
+/**
+ *  call-seq:
+ *    Coolio::NativeAsyncWatcher#on_signal -> nil
+ *
+ * Called once per loop iteration in which the watcher was signalled
+ */
+static VALUE Coolio_NativeAsyncWatcher_on_signal(VALUE self)
+{
+  return Qnil;
+}
+
+/* libev callback */
+static void Coolio_NativeAsyncWatcher_libev_callback(struct ev_loop *ev_loop, struct ev_async *async, int revents)
+{
+  Coolio_Loop_process_event((VALUE)async->data, revents);
+}
+
+/* Coolio::Loop dispatch callback */
+static void Coolio_NativeAsyncWatcher_dispatch_callback(VALUE self, int revents)
+{
+  if(revents & EV_ASYNC)
+    rb_funcall(self, rb_intern("on_signal"), 0);
+  else
+    rb_raise(rb_eRuntimeError, "unknown revents value for ev_async: %d", revents);
+}
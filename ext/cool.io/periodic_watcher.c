@@ -0,0 +1,347 @@
+/*
+ * Copyright (C) 2007-10 Tony Arcieri
+ * You may redistribute this under the terms of the Ruby license.
+ * See LICENSE for details
+ */
+
+#include <math.h>
+
+#include "ruby.h"
+#include "ev_wrap.h"
+
+#include "cool.io.h"
+#include "watcher.h"
+
+static VALUE mCoolio = Qnil;
+static VALUE cCoolio_Watcher = Qnil;
+static VALUE cCoolio_PeriodicWatcher = Qnil;
+static VALUE cCoolio_Loop = Qnil;
+
+static VALUE Coolio_PeriodicWatcher_allocate(VALUE klass);
+static size_t Coolio_PeriodicWatcher_memsize(const void *data);
+
+static VALUE Coolio_PeriodicWatcher_initialize(int argc, VALUE *argv, VALUE self);
+static VALUE Coolio_PeriodicWatcher_attach(VALUE self, VALUE loop);
+static VALUE Coolio_PeriodicWatcher_detach(VALUE self);
+static VALUE Coolio_PeriodicWatcher_enable(VALUE self);
+static VALUE Coolio_PeriodicWatcher_disable(VALUE self);
+static VALUE Coolio_PeriodicWatcher_again(VALUE self);
+static VALUE Coolio_PeriodicWatcher_at(VALUE self);
+static VALUE Coolio_PeriodicWatcher_interval(VALUE self);
+static VALUE Coolio_PeriodicWatcher_offset(VALUE self);
+static VALUE Coolio_PeriodicWatcher_on_timer(VALUE self);
+
+static void Coolio_PeriodicWatcher_raise_reschedule_error(VALUE self);
+static VALUE Coolio_PeriodicWatcher_call_reschedule(VALUE args);
+static ev_tstamp Coolio_PeriodicWatcher_reschedule_callback(struct ev_periodic *periodic, ev_tstamp now);
+static void Coolio_PeriodicWatcher_libev_callback(struct ev_loop *ev_loop, struct ev_periodic *periodic, int revents);
+static void Coolio_PeriodicWatcher_dispatch_callback(VALUE self, int revents);
+
+/*
+ * Coolio::PeriodicWatcher fires at points in wall clock time rather than
+ * after a duration, so it stays aligned to e.g. every 10 seconds past the
+ * minute however late the loop runs, and follows changes to the system
+ * clock.  The schedule is kept in libev's timer heap and doesn't involve
+ * any Ruby until the watcher fires, unless a reschedule block is given.
+ */
+void Init_coolio_periodic_watcher()
+{
+  mCoolio = rb_define_module("Coolio");
+  cCoolio_Watcher = rb_define_class_under(mCoolio, "Watcher", rb_cObject);
+  cCoolio_PeriodicWatcher = rb_define_class_under(mCoolio, "PeriodicWatcher", cCoolio_Watcher);
+  rb_define_alloc_func(cCoolio_PeriodicWatcher, Coolio_PeriodicWatcher_allocate);
+  cCoolio_Loop = rb_define_class_under(mCoolio, "Loop", rb_cObject);
+
+  rb_define_method(cCoolio_PeriodicWatcher, "initialize", Coolio_PeriodicWatcher_initialize, -1);
+  rb_define_method(cCoolio_PeriodicWatcher, "attach", Coolio_PeriodicWatcher_attach, 1);
+  rb_define_method(cCoolio_PeriodicWatcher, "detach", Coolio_PeriodicWatcher_detach, 0);
+  rb_define_method(cCoolio_PeriodicWatcher, "enable", Coolio_PeriodicWatcher_enable, 0);
+  rb_define_method(cCoolio_PeriodicWatcher, "disable", Coolio_PeriodicWatcher_disable, 0);
+  rb_define_method(cCoolio_PeriodicWatcher, "again", Coolio_PeriodicWatcher_again, 0);
+  rb_define_method(cCoolio_PeriodicWatcher, "at", Coolio_PeriodicWatcher_at, 0);
+  rb_define_method(cCoolio_PeriodicWatcher, "interval", Coolio_PeriodicWatcher_interval, 0);
+  rb_define_method(cCoolio_PeriodicWatcher, "offset", Coolio_PeriodicWatcher_offset, 0);
+  rb_define_method(cCoolio_PeriodicWatcher, "on_timer", Coolio_PeriodicWatcher_on_timer, 0);
+}
+
+static const rb_data_type_t Coolio_PeriodicWatcher_type = {
+  "Coolio::PeriodicWatcher",
+  {
+    Coolio_Watcher_mark,
+    RUBY_DEFAULT_FREE,
+    Coolio_PeriodicWatcher_memsize,
+  },
+  &Coolio_Watcher_type,
+};
+
+static VALUE Coolio_PeriodicWatcher_allocate(VALUE klass)
+{
+  struct Coolio_Watcher_periodic *watcher_data;
+  VALUE watcher = TypedData_Make_Struct(klass, struct Coolio_Watcher_periodic, &Coolio_PeriodicWatcher_type, watcher_data);
+
+  Coolio_Watcher_setup(watcher, &watcher_data->watcher);
+
+  return watcher;
+}
+
+static size_t Coolio_PeriodicWatcher_memsize(const void *data)
+{
+  return sizeof(struct Coolio_Watcher_periodic);
+}
+
+/**
+ *  call-seq:
+ *    Coolio::PeriodicWatcher.initialize(interval, offset = 0) -> Coolio::PeriodicWatcher
+ *    Coolio::PeriodicWatcher.initialize { |now| next_time } -> Coolio::PeriodicWatcher
+ *
+ * Create a new Coolio::PeriodicWatcher.  Given an interval, it fires
+ * whenever the time (in seconds since the epoch) is a multiple of interval
+ * plus offset, so PeriodicWatcher.new(10) fires on every tenth second.
+ * With an interval of 0 it fires once, at the absolute time given by offset.
+ *
+ * Given a block instead, the block is called with the current time
+ * whenever the watcher is started or has fired, and returns when it should
+ * fire next, which must not be before that current time.  The block must
+ * not start or stop any watchers.
+ */
+static VALUE Coolio_PeriodicWatcher_initialize(int argc, VALUE *argv, VALUE self)
+{
+  VALUE interval, offset, reschedule;
+  struct Coolio_Watcher *watcher_data;
+
+  rb_scan_args(argc, argv, "02&", &interval, &offset, &reschedule);
+
+  if(reschedule == Qnil && interval == Qnil)
+    rb_raise(rb_eArgError, "expected an interval or a reschedule block");
+
+  interval = interval == Qnil ? rb_float_new(0) : rb_convert_type(interval, T_FLOAT, "Float", "to_f");
+  offset = offset == Qnil ? rb_float_new(0) : rb_convert_type(offset, T_FLOAT, "Float", "to_f");
+
+  if(NUM2DBL(interval) < 0)
+    rb_raise(rb_eArgError, "interval must not be negative");
+
+  rb_iv_set(self, "@reschedule", reschedule);
+  rb_iv_set(self, "@reschedule_error", Qnil);
+
+  watcher_data = Coolio_Watcher_ptr(self);
+
+  watcher_data->dispatch_callback = Coolio_PeriodicWatcher_dispatch_callback;
+  ev_periodic_init(
+      Coolio_Watcher_ev(watcher_data, periodic),
+      Coolio_PeriodicWatcher_libev_callback,
+      NUM2DBL(offset),
+      NUM2DBL(interval),
+      reschedule == Qnil ? 0 : Coolio_PeriodicWatcher_reschedule_callback
+  );
+  Coolio_Watcher_ev(watcher_data, periodic)->data = (void *)self;
+
+  return Qnil;
+}
+
+/**
+ *  call-seq:
+ *    Coolio::PeriodicWatcher.attach(loop) -> Coolio::PeriodicWatcher
+ *
+ * Attach the periodic watcher to the given Coolio::Loop.  If the watcher is already
+ * attached to a loop, detach it from the old one and attach it to the new one.
+ */
+static VALUE Coolio_PeriodicWatcher_attach(VALUE self, VALUE loop)
+{
+  Watcher_Attach(periodic, Coolio_PeriodicWatcher_detach, self, loop);
+  Coolio_PeriodicWatcher_raise_reschedule_error(self);
+
+  return self;
+}
+
+/**
+ *  call-seq:
+ *    Coolio::PeriodicWatcher.detach -> Coolio::PeriodicWatcher
+ *
+ * Detach the periodic watcher from its current Coolio::Loop.
+ */
+static VALUE Coolio_PeriodicWatcher_detach(VALUE self)
+{
+  Watcher_Detach(periodic, self);
+
+  return self;
+}
+
+/**
+ *  call-seq:
+ *    Coolio::PeriodicWatcher.enable -> Coolio::PeriodicWatcher
+ *
+ * Re-enable a periodic watcher which has been temporarily disabled.  See the
+ * disable method for a more thorough explanation.
+ */
+static VALUE Coolio_PeriodicWatcher_enable(VALUE self)
+{
+  Watcher_Enable(periodic, self);
+  Coolio_PeriodicWatcher_raise_reschedule_error(self);
+
+  return self;
+}
+
+/**
+ *  call-seq:
+ *    Coolio::PeriodicWatcher.disable -> Coolio::PeriodicWatcher
+ *
+ * Temporarily disable a periodic watcher which is attached to a loop.
+ * This is useful if you wish to toggle event monitoring on and off.
+ */
+static VALUE Coolio_PeriodicWatcher_disable(VALUE self)
+{
+  Watcher_Disable(periodic, self);
+
+  return self;
+}
+
+/**
+ *  call-seq:
+ *    Coolio::PeriodicWatcher#again -> Coolio::PeriodicWatcher
+ *
+ * Work out when the watcher should fire next from scratch, e.g. because
+ * what the reschedule block returns has changed.
+ */
+static VALUE Coolio_PeriodicWatcher_again(VALUE self)
+{
+  struct Coolio_Watcher *watcher_data;
+
+  watcher_data = Coolio_Watcher_ptr(self);
+
+  if(watcher_data->loop == Qnil)
+    rb_raise(rb_eRuntimeError, "not attached to a loop");
+
+  if(watcher_data->enabled) {
+    ev_periodic_again(Coolio_Loop_ptr(watcher_data->loop)->ev_loop, Coolio_Watcher_ev(watcher_data, periodic));
+    Coolio_PeriodicWatcher_raise_reschedule_error(self);
+  }
+
+  return self;
+}
+
+/**
+ *  call-seq:
+ *    Coolio::PeriodicWatcher#at -> Float
+ *
+ * Time (in seconds since the epoch) the watcher fires next, if it's enabled
+ */
+static VALUE Coolio_PeriodicWatcher_at(VALUE self)
+{
+  return rb_float_new(ev_periodic_at(Coolio_Watcher_ev(Coolio_Watcher_ptr(self), periodic)));
+}
+
+/**
+ *  call-seq:
+ *    Coolio::PeriodicWatcher#interval -> Float
+ *
+ * Interval between firings, or 0 for one-shot and rescheduled watchers
+ */
+static VALUE Coolio_PeriodicWatcher_interval(VALUE self)
+{
+  return rb_float_new(Coolio_Watcher_ev(Coolio_Watcher_ptr(self), periodic)->interval);
+}
+
+/**
+ *  call-seq:
+ *    Coolio::PeriodicWatcher#offset -> Float
+ *
+ * Offset of the firings from multiples of the interval
+ */
+static VALUE Coolio_PeriodicWatcher_offset(VALUE self)
+{
+  return rb_float_new(Coolio_Watcher_ev(Coolio_Watcher_ptr(self), periodic)->offset);
+}
+
+/**
+ *  call-seq:
+ *    Coolio::PeriodicWatcher#on_timer -> nil
+ *
+ * Called whenever the PeriodicWatcher fires.  One-shot watchers are
+ * detached beforehand.
+ */
+static VALUE Coolio_PeriodicWatcher_on_timer(VALUE self)
+{
+  return Qnil;
+}
+
+/* Raise what the reschedule block raised, if anything */
+static void Coolio_PeriodicWatcher_raise_reschedule_error(VALUE self)
+{
+  VALUE error = rb_iv_get(self, "@reschedule_error");
+
+  if(error != Qnil) {
+    rb_iv_set(self, "@reschedule_error", Qnil);
+    rb_exc_raise(error);
+  }
+}
+
+static VALUE Coolio_PeriodicWatcher_call_reschedule(VALUE args)
+{
+  VALUE self = RARRAY_AREF(args, 0);
+  VALUE now = RARRAY_AREF(args, 1);
+
+  return rb_convert_type(
+      rb_funcall(rb_iv_get(self, "@reschedule"), rb_intern("call"), 1, now),
+      T_FLOAT, "Float", "to_f"
+  );
+}
+
+/* libev reschedule callback, may be run in the middle of ev_run */
+static ev_tstamp Coolio_PeriodicWatcher_reschedule_callback(struct ev_periodic *periodic, ev_tstamp now)
+{
+  VALUE self = (VALUE)periodic->data;
+  VALUE result;
+  struct Coolio_Watcher *watcher_data;
+  int state = 0;
+  ev_tstamp at;
+
+  result = rb_protect(Coolio_PeriodicWatcher_call_reschedule, rb_assoc_new(self, rb_float_new(now)), &state);
+
+  if(!state) {
+    at = NUM2DBL(result);
+
+    /* NaN would slip past the comparison and into libev's heap */
+    if(isfinite(at))
+      return at < now ? now : at;
+
+    rb_iv_set(self, "@reschedule_error",
+        rb_exc_new_cstr(rb_eArgError, "reschedule block must return a finite time"));
+  } else {
+    rb_iv_set(self, "@reschedule_error", rb_errinfo());
+    rb_set_errinfo(Qnil);
+  }
+
+  /* Unwinding through libev isn't an option.  Park the watcher and raise
+   * the error from the loop's dispatch, or from whichever method of ours
+   * started the watcher when the loop isn't running. */
+
+  watcher_data = Coolio_Watcher_ptr(self);
+  if(watcher_data->loop != Qnil && ev_depth(Coolio_Loop_ptr(watcher_data->loop)->ev_loop) > 0)
+    Coolio_Loop_process_event(self, EV_CUSTOM);
+
+  return now + 1e30;
+}
+
+/* libev callback */
+static void Coolio_PeriodicWatcher_libev_callback(struct ev_loop *ev_loop, struct ev_periodic *periodic, int revents)
+{
+  Coolio_Loop_process_event((VALUE)periodic->data, revents);
+}
+
+/* Coolio::Loop dispatch callback */
+static void Coolio_PeriodicWatcher_dispatch_callback(VALUE self, int revents)
+{
+  struct Coolio_Watcher *watcher_data = Coolio_Watcher_ptr(self);
+
+  if(revents & EV_CUSTOM)
+    Coolio_PeriodicWatcher_raise_reschedule_error(self);
+
+  if(!(revents & EV_PERIODIC))
+    rb_raise(rb_eRuntimeError, "unknown revents value for ev_periodic: %d", revents);
+
+  /* libev stops one-shot watchers once they've fired */
+  if(watcher_data->loop != Qnil && !ev_is_active(Coolio_Watcher_ev(watcher_data, periodic)))
+    rb_funcall(self, rb_intern("detach"), 0);
+
+  rb_funcall(self, rb_intern("on_timer"), 0);
+}
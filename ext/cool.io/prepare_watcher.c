@@ -0,0 +1,172 @@
+/*
+ * Copyright (C) 2007-10 Tony Arcieri
+ * You may redistribute this under the terms of the Ruby license.
+ * See LICENSE for details
+ */
+
+#include "ruby.h"
+#include "ev_wrap.h"
+
+#include "cool.io.h"
+#include "watcher.h"
+
+static VALUE mCoolio = Qnil;
+static VALUE cCoolio_Watcher = Qnil;
+static VALUE cCoolio_PrepareWatcher = Qnil;
+static VALUE cCoolio_Loop = Qnil;
+
+static VALUE Coolio_PrepareWatcher_allocate(VALUE klass);
+static size_t Coolio_PrepareWatcher_memsize(const void *data);
+
+static VALUE Coolio_PrepareWatcher_initialize(VALUE self);
+static VALUE Coolio_PrepareWatcher_attach(VALUE self, VALUE loop);
+static VALUE Coolio_PrepareWatcher_detach(VALUE self);
+static VALUE Coolio_PrepareWatcher_enable(VALUE self);
+static VALUE Coolio_PrepareWatcher_disable(VALUE self);
+static VALUE Coolio_PrepareWatcher_on_prepare(VALUE self);
+
+static void Coolio_PrepareWatcher_libev_callback(struct ev_loop *ev_loop, struct ev_prepare *prepare, int revents);
+static void Coolio_PrepareWatcher_dispatch_callback(VALUE self, int revents);
+
+/*
+ * Coolio::PrepareWatcher calls on_prepare once per loop iteration, before
+ * the callbacks for the other events received during that iteration.
+ */
+void Init_coolio_prepare_watcher()
+{
+  mCoolio = rb_define_module("Coolio");
+  cCoolio_Watcher = rb_define_class_under(mCoolio, "Watcher", rb_cObject);
+  cCoolio_PrepareWatcher = rb_define_class_under(mCoolio, "PrepareWatcher", cCoolio_Watcher);
+  rb_define_alloc_func(cCoolio_PrepareWatcher, Coolio_PrepareWatcher_allocate);
+  cCoolio_Loop = rb_define_class_under(mCoolio, "Loop", rb_cObject);
+
+  rb_define_method(cCoolio_PrepareWatcher, "initialize", Coolio_PrepareWatcher_initialize, 0);
+  rb_define_method(cCoolio_PrepareWatcher, "attach", Coolio_PrepareWatcher_attach, 1);
+  rb_define_method(cCoolio_PrepareWatcher, "detach", Coolio_PrepareWatcher_detach, 0);
+  rb_define_method(cCoolio_PrepareWatcher, "enable", Coolio_PrepareWatcher_enable, 0);
+  rb_define_method(cCoolio_PrepareWatcher, "disable", Coolio_PrepareWatcher_disable, 0);
+  rb_define_method(cCoolio_PrepareWatcher, "on_prepare", Coolio_PrepareWatcher_on_prepare, 0);
+}
+
+static const rb_data_type_t Coolio_PrepareWatcher_type = {
+  "Coolio::PrepareWatcher",
+  {
+    Coolio_Watcher_mark,
+    RUBY_DEFAULT_FREE,
+    Coolio_PrepareWatcher_memsize,
+  },
+  &Coolio_Watcher_type,
+};
+
+static VALUE Coolio_PrepareWatcher_allocate(VALUE klass)
+{
+  struct Coolio_Watcher_prepare *watcher_data;
+  VALUE watcher = TypedData_Make_Struct(klass, struct Coolio_Watcher_prepare, &Coolio_PrepareWatcher_type, watcher_data);
+
+  Coolio_Watcher_setup(watcher, &watcher_data->watcher);
+
+  return watcher;
+}
+
+static size_t Coolio_PrepareWatcher_memsize(const void *data)
+{
+  return sizeof(struct Coolio_Watcher_prepare);
+}
+
+/**
+ *  call-seq:
+ *    Coolio::PrepareWatcher.initialize -> Coolio::PrepareWatcher
+ *
+ * Create a new Coolio::PrepareWatcher
+ */
+static VALUE Coolio_PrepareWatcher_initialize(VALUE self)
+{
+  struct Coolio_Watcher *watcher_data = Coolio_Watcher_ptr(self);
+
+  watcher_data->dispatch_callback = Coolio_PrepareWatcher_dispatch_callback;
+  ev_prepare_init(Coolio_Watcher_ev(watcher_data, prepare), Coolio_PrepareWatcher_libev_callback);
+  Coolio_Watcher_ev(watcher_data, prepare)->data = (void *)self;
+
+  return Qnil;
+}
+
+/**
+ *  call-seq:
+ *    Coolio::PrepareWatcher.attach(loop) -> Coolio::PrepareWatcher
+ *
+ * Attach the prepare watcher to the given Coolio::Loop.  If the watcher is already
+ * attached to a loop, detach it from the old one and attach it to the new one.
+ */
+static VALUE Coolio_PrepareWatcher_attach(VALUE self, VALUE loop)
+{
+  Watcher_Attach(prepare, Coolio_PrepareWatcher_detach, self, loop);
+
+  return self;
+}
+
+/**
+ *  call-seq:
+ *    Coolio::PrepareWatcher.detach -> Coolio::PrepareWatcher
+ *
+ * Detach the prepare watcher from its current Coolio::Loop.
+ */
+static VALUE Coolio_PrepareWatcher_detach(VALUE self)
+{
+  Watcher_Detach(prepare, self);
+
+  return self;
+}
+
+/**
+ *  call-seq:
+ *    Coolio::PrepareWatcher.enable -> Coolio::PrepareWatcher
+ *
+ * Re-enable a prepare watcher which has been temporarily disabled.  See the
+ * disable method for a more thorough explanation.
+ */
+static VALUE Coolio_PrepareWatcher_enable(VALUE self)
+{
+  Watcher_Enable(prepare, self);
+
+  return self;
+}
+
+/**
+ *  call-seq:
+ *    Coolio::PrepareWatcher.disable -> Coolio::PrepareWatcher
+ *
+ * Temporarily disable a prepare watcher which is attached to a loop.
+ * This is useful if you wish to toggle event monitoring on and off.
+ */
+static VALUE Coolio_PrepareWatcher_disable(VALUE self)
+{
+  Watcher_Disable(prepare, self);
+
+  return self;
+}
+
+/**
+ *  call-seq:
+ *    Coolio::PrepareWatcher#on_prepare -> nil
+ *
+ * Called once per loop iteration, before the other callbacks of the iteration
+ */
+static VALUE Coolio_PrepareWatcher_on_prepare(VALUE self)
+{
+  return Qnil;
+}
+
+/* libev callback */
+static void Coolio_PrepareWatcher_libev_callback(struct ev_loop *ev_loop, struct ev_prepare *prepare, int revents)
+{
+  Coolio_Loop_process_event((VALUE)prepare->data, revents);
+}
+
+/* Coolio::Loop dispatch callback */
+static void Coolio_PrepareWatcher_dispatch_callback(VALUE self, int revents)
+{
+  if(revents & EV_PREPARE)
+    rb_funcall(self, rb_intern("on_prepare"), 0);
+  else
+    rb_raise(rb_eRuntimeError, "unknown revents value for ev_prepare: %d", revents);
+}
@@ -0,0 +1,358 @@
+/*
+ * Copyright (C) 2007-10 Tony Arcieri
+ * You may redistribute this under the terms of the Ruby license.
+ * See LICENSE for details
+ */
+
+#include "ruby.h"
+#include <signal.h>
+#include <string.h>
+
+#include "ev_wrap.h"
+
+#include "cool.io.h"
+#include "watcher.h"
+
+#ifndef NSIG
+#define NSIG 65
+#endif
+
+static VALUE mCoolio = Qnil;
+static VALUE cCoolio_Watcher = Qnil;
+static VALUE cCoolio_SignalWatcher = Qnil;
+static VALUE cCoolio_Loop = Qnil;
+
+/* Signal watchers which are enabled, kept from being garbage collected */
+static VALUE Coolio_SignalWatcher_enabled = Qnil;
+
+/* A signal can only be watched by one loop at a time.  What the signal was
+ * handled by before cool.io took it over is restored when it's released. */
+static struct {
+  struct ev_loop *ev_loop;
+  int watchers;
+#ifndef _WIN32
+  struct sigaction previous;
+#endif
+} Coolio_SignalWatcher_signals[NSIG];
+
+static VALUE Coolio_SignalWatcher_allocate(VALUE klass);
+static size_t Coolio_SignalWatcher_memsize(const void *data);
+
+static VALUE Coolio_SignalWatcher_initialize(VALUE self, VALUE signal);
+static VALUE Coolio_SignalWatcher_attach(VALUE self, VALUE loop);
+static VALUE Coolio_SignalWatcher_detach(VALUE self);
+static VALUE Coolio_SignalWatcher_enable(VALUE self);
+static VALUE Coolio_SignalWatcher_disable(VALUE self);
+static VALUE Coolio_SignalWatcher_signum(VALUE self);
+static VALUE Coolio_SignalWatcher_on_signal(VALUE self);
+
+static int Coolio_SignalWatcher_parse_signal(VALUE signal);
+static void Coolio_SignalWatcher_claim(VALUE self, struct Coolio_Loop *loop_data);
+static void Coolio_SignalWatcher_start(VALUE self, struct Coolio_Loop *loop_data);
+static void Coolio_SignalWatcher_stop(VALUE self, struct Coolio_Loop *loop_data);
+
+static void Coolio_SignalWatcher_libev_callback(struct ev_loop *ev_loop, struct ev_signal *signal, int revents);
+static void Coolio_SignalWatcher_dispatch_callback(VALUE self, int revents);
+
+/*
+ * Coolio::SignalWatcher calls on_signal when the process receives a given
+ * signal.  The signal is caught by libev, which wakes up the loop, and the
+ * callback runs on the loop's thread like any other.  Signals which arrive
+ * again before the loop gets around to dispatching them are coalesced.
+ *
+ * While enabled, the watcher replaces any handler installed with
+ * Signal.trap for its signal.  That handler is put back once no watchers
+ * for the signal remain enabled.  Each signal may only be watched by one
+ * loop at a time.
+ */
+void Init_coolio_signal_watcher()
+{
+  mCoolio = rb_define_module("Coolio");
+  cCoolio_Watcher = rb_define_class_under(mCoolio, "Watcher", rb_cObject);
+  cCoolio_SignalWatcher = rb_define_class_under(mCoolio, "SignalWatcher", cCoolio_Watcher);
+  rb_define_alloc_func(cCoolio_SignalWatcher, Coolio_SignalWatcher_allocate);
+  cCoolio_Loop = rb_define_class_under(mCoolio, "Loop", rb_cObject);
+
+  rb_define_method(cCoolio_SignalWatcher, "initialize", Coolio_SignalWatcher_initialize, 1);
+  rb_define_method(cCoolio_SignalWatcher, "attach", Coolio_SignalWatcher_attach, 1);
+  rb_define_method(cCoolio_SignalWatcher, "detach", Coolio_SignalWatcher_detach, 0);
+  rb_define_method(cCoolio_SignalWatcher, "enable", Coolio_SignalWatcher_enable, 0);
+  rb_define_method(cCoolio_SignalWatcher, "disable", Coolio_SignalWatcher_disable, 0);
+  rb_define_method(cCoolio_SignalWatcher, "signum", Coolio_SignalWatcher_signum, 0);
+  rb_define_method(cCoolio_SignalWatcher, "on_signal", Coolio_SignalWatcher_on_signal, 0);
+
+  Coolio_SignalWatcher_enabled = rb_ary_new();
+  rb_global_variable(&Coolio_SignalWatcher_enabled);
+}
+
+static const rb_data_type_t Coolio_SignalWatcher_type = {
+  "Coolio::SignalWatcher",
+  {
+    Coolio_Watcher_mark,
+    RUBY_DEFAULT_FREE,
+    Coolio_SignalWatcher_memsize,
+  },
+  &Coolio_Watcher_type,
+};
+
+static VALUE Coolio_SignalWatcher_allocate(VALUE klass)
+{
+  struct Coolio_Watcher_signal *watcher_data;
+  VALUE watcher = TypedData_Make_Struct(klass, struct Coolio_Watcher_signal, &Coolio_SignalWatcher_type, watcher_data);
+
+  Coolio_Watcher_setup(watcher, &watcher_data->watcher);
+
+  return watcher;
+}
+
+static size_t Coolio_SignalWatcher_memsize(const void *data)
+{
+  return sizeof(struct Coolio_Watcher_signal);
+}
+
+/* Convert a signal number or name ('HUP', :SIGHUP, ...) into a signal number */
+static int Coolio_SignalWatcher_parse_signal(VALUE signal)
+{
+  VALUE name, signum;
+  int num;
+
+  if(FIXNUM_P(signal)) {
+    num = FIX2INT(signal);
+  } else {
+    name = rb_String(signal);
+    if(RSTRING_LEN(name) > 3 && !strncmp(RSTRING_PTR(name), "SIG", 3))
+      name = rb_str_substr(name, 3, RSTRING_LEN(name) - 3);
+
+    signum = rb_hash_aref(rb_funcall(rb_path2class("Signal"), rb_intern("list"), 0), name);
+    if(signum == Qnil)
+      rb_raise(rb_eArgError, "unsupported signal 'SIG%s'", RSTRING_PTR(name));
+
+    num = NUM2INT(signum);
+  }
+
+  if(num <= 0 || num >= NSIG)
+    rb_raise(rb_eArgError, "invalid signal number (%d)", num);
+
+  /* The same signals Signal.trap refuses, they're needed by Ruby itself or
+   * can't be caught at all */
+  switch(num) {
+#ifdef SIGSEGV
+    case SIGSEGV:
+#endif
+#ifdef SIGBUS
+    case SIGBUS:
+#endif
+#ifdef SIGILL
+    case SIGILL:
+#endif
+#ifdef SIGFPE
+    case SIGFPE:
+#endif
+#ifdef SIGVTALRM
+    case SIGVTALRM:
+#endif
+#ifdef SIGKILL
+    case SIGKILL:
+#endif
+#ifdef SIGSTOP
+    case SIGSTOP:
+#endif
+      rb_raise(rb_eArgError, "can't watch reserved signal %d", num);
+  }
+
+  return num;
+}
+
+/**
+ *  call-seq:
+ *    Coolio::SignalWatcher.initialize(signal) -> Coolio::SignalWatcher
+ *
+ * Create a new Coolio::SignalWatcher for the given signal, which may be
+ * given as a number or as a name such as 'HUP', 'SIGUSR2' or :TERM.
+ */
+static VALUE Coolio_SignalWatcher_initialize(VALUE self, VALUE signal)
+{
+  struct Coolio_Watcher *watcher_data = Coolio_Watcher_ptr(self);
+  int signum = Coolio_SignalWatcher_parse_signal(signal);
+
+  watcher_data->dispatch_callback = Coolio_SignalWatcher_dispatch_callback;
+  ev_signal_init(Coolio_Watcher_ev(watcher_data, signal), Coolio_SignalWatcher_libev_callback, signum);
+  Coolio_Watcher_ev(watcher_data, signal)->data = (void *)self;
+
+  return Qnil;
+}
+
+/* Make sure the watcher's signal isn't taken by another loop */
+static void Coolio_SignalWatcher_claim(VALUE self, struct Coolio_Loop *loop_data)
+{
+  int signum = Coolio_Watcher_ev(Coolio_Watcher_ptr(self), signal)->signum;
+  struct ev_loop *owner = Coolio_SignalWatcher_signals[signum].ev_loop;
+
+  if(owner && owner != loop_data->ev_loop)
+    rb_raise(rb_eRuntimeError, "signal %d is already watched by another loop", signum);
+}
+
+/* Start watching the signal, taking it over from Ruby if needed */
+static void Coolio_SignalWatcher_start(VALUE self, struct Coolio_Loop *loop_data)
+{
+  struct ev_signal *ev_signal = Coolio_Watcher_ev(Coolio_Watcher_ptr(self), signal);
+  int signum = ev_signal->signum;
+
+  if(Coolio_SignalWatcher_signals[signum].watchers++ == 0) {
+#ifndef _WIN32
+    sigaction(signum, 0, &Coolio_SignalWatcher_signals[signum].previous);
+#endif
+    Coolio_SignalWatcher_signals[signum].ev_loop = loop_data->ev_loop;
+  }
+
+  ev_signal_start(loop_data->ev_loop, ev_signal);
+  rb_ary_push(Coolio_SignalWatcher_enabled, self);
+}
+
+/* Stop watching the signal, handing it back once nothing watches it */
+static void Coolio_SignalWatcher_stop(VALUE self, struct Coolio_Loop *loop_data)
+{
+  struct ev_signal *ev_signal = Coolio_Watcher_ev(Coolio_Watcher_ptr(self), signal);
+  int signum = ev_signal->signum;
+
+  ev_signal_stop(loop_data->ev_loop, ev_signal);
+  rb_ary_delete(Coolio_SignalWatcher_enabled, self);
+
+  /* libev leaves the signal at SIG_DFL, which would make e.g. SIGHUP fatal */
+  if(--Coolio_SignalWatcher_signals[signum].watchers == 0) {
+#ifndef _WIN32
+    sigaction(signum, &Coolio_SignalWatcher_signals[signum].previous, 0);
+#endif
+    Coolio_SignalWatcher_signals[signum].ev_loop = 0;
+  }
+}
+
+/**
+ *  call-seq:
+ *    Coolio::SignalWatcher.attach(loop) -> Coolio::SignalWatcher
+ *
+ * Attach the signal watcher to the given Coolio::Loop.  If the watcher is already
+ * attached to a loop, detach it from the old one and attach it to the new one.
+ */
+static VALUE Coolio_SignalWatcher_attach(VALUE self, VALUE loop)
+{
+  struct Coolio_Watcher *watcher_data;
+  struct Coolio_Loop *loop_data;
+
+  if(!rb_obj_is_kind_of(loop, cCoolio_Loop))
+    rb_raise(rb_eArgError, "expected loop to be an instance of Coolio::Loop, not %s", RSTRING_PTR(rb_inspect(loop)));
+
+  watcher_data = Coolio_Watcher_ptr(self);
+  loop_data = Coolio_Loop_ptr(loop);
+
+  if(watcher_data->loop != Qnil)
+    Coolio_SignalWatcher_detach(self);
+
+  Coolio_SignalWatcher_claim(self, loop_data);
+
+  watcher_data->loop = loop;
+  Coolio_SignalWatcher_start(self, loop_data);
+  rb_call_super(1, &loop);
+
+  return self;
+}
+
+/**
+ *  call-seq:
+ *    Coolio::SignalWatcher.detach -> Coolio::SignalWatcher
+ *
+ * Detach the signal watcher from its current Coolio::Loop.
+ */
+static VALUE Coolio_SignalWatcher_detach(VALUE self)
+{
+  Watcher_Detach(signal, self);
+
+  return self;
+}
+
+/**
+ *  call-seq:
+ *    Coolio::SignalWatcher.enable -> Coolio::SignalWatcher
+ *
+ * Re-enable a signal watcher which has been temporarily disabled.  See the
+ * disable method for a more thorough explanation.
+ */
+static VALUE Coolio_SignalWatcher_enable(VALUE self)
+{
+  struct Coolio_Watcher *watcher_data;
+  struct Coolio_Loop *loop_data;
+
+  watcher_data = Coolio_Watcher_ptr(self);
+
+  if(watcher_data->loop == Qnil)
+    rb_raise(rb_eRuntimeError, "not attached to a loop");
+
+  loop_data = Coolio_Loop_ptr(watcher_data->loop);
+  Coolio_SignalWatcher_claim(self, loop_data);
+
+  rb_call_super(0, 0);
+  Coolio_SignalWatcher_start(self, loop_data);
+
+  return self;
+}
+
+/**
+ *  call-seq:
+ *    Coolio::SignalWatcher.disable -> Coolio::SignalWatcher
+ *
+ * Temporarily disable a signal watcher which is attached to a loop.  The
+ * signal is handled as it was before while no watchers for it are enabled.
+ */
+static VALUE Coolio_SignalWatcher_disable(VALUE self)
+{
+  struct Coolio_Watcher *watcher_data;
+
+  watcher_data = Coolio_Watcher_ptr(self);
+
+  if(watcher_data->loop == Qnil)
+    rb_raise(rb_eRuntimeError, "not attached to a loop");
+
+  if(watcher_data->enabled)
+    Coolio_SignalWatcher_stop(self, Coolio_Loop_ptr(watcher_data->loop));
+
+  rb_call_super(0, 0);
+
+  return self;
+}
+
+/**
+ *  call-seq:
+ *    Coolio::SignalWatcher#signum -> Integer
+ *
+ * Number of the signal being watched
+ */
+static VALUE Coolio_SignalWatcher_signum(VALUE self)
+{
+  return INT2NUM(Coolio_Watcher_ev(Coolio_Watcher_ptr(self), signal)->signum);
+}
+
+/**
+ *  call-seq:
+ *    Coolio::SignalWatcher#on_signal -> nil
+ *
+ * Called whenever the signal has been received
+ */
+static VALUE Coolio_SignalWatcher_on_signal(VALUE self)
+{
+  return Qnil;
+}
+
+/* libev callback */
+static void Coolio_SignalWatcher_libev_callback(struct ev_loop *ev_loop, struct ev_signal *signal, int revents)
+{
+  Coolio_Loop_process_event((VALUE)signal->data, revents);
+}
+
+/* Coolio::Loop dispatch callback */
+static void Coolio_SignalWatcher_dispatch_callback(VALUE self, int revents)
+{
+  if(revents & EV_SIGNAL)
+    rb_funcall(self, rb_intern("on_signal"), 0);
+  else
+    rb_raise(rb_eRuntimeError, "unknown revents value for ev_signal: %d", revents);
+}
@@ -16,6 +16,9 @@ static VALUE cCoolio_StatWatcher = Qnil;
 static VALUE cCoolio_StatInfo = Qnil;
 static VALUE cCoolio_Loop = Qnil;
 
+static VALUE Coolio_StatWatcher_allocate(VALUE klass);
+static size_t Coolio_StatWatcher_memsize(const void *data);
+
 static VALUE Coolio_StatWatcher_initialize(int argc, VALUE *argv, VALUE self);
 static VALUE Coolio_StatWatcher_attach(VALUE self, VALUE loop);
 static VALUE Coolio_StatWatcher_detach(VALUE self);
@@ -39,6 +42,7 @@ void Init_coolio_stat_watcher()
   mCoolio = rb_define_module("Coolio");
   cCoolio_Watcher = rb_define_class_under(mCoolio, "Watcher", rb_cObject);
   cCoolio_StatWatcher = rb_define_class_under(mCoolio, "StatWatcher", cCoolio_Watcher);
+  rb_define_alloc_func(cCoolio_StatWatcher, Coolio_StatWatcher_allocate);
   cCoolio_StatInfo = rb_struct_define("StatInfo",
       "mtime",
       "ctime",
@@ -65,6 +69,31 @@ void Init_coolio_stat_watcher()
   rb_define_method(cCoolio_StatWatcher, "path", Coolio_StatWatcher_path, 0);
 }
 
+static const rb_data_type_t Coolio_StatWatcher_type = {
+  "Coolio::StatWatcher",
+  {
+    Coolio_Watcher_mark,
+    RUBY_DEFAULT_FREE,
+    Coolio_StatWatcher_memsize,
+  },
+  &Coolio_Watcher_type,
+};
+
+static VALUE Coolio_StatWatcher_allocate(VALUE klass)
+{
+  struct Coolio_Watcher_stat *watcher_data;
+  VALUE watcher = TypedData_Make_Struct(klass, struct Coolio_Watcher_stat, &Coolio_StatWatcher_type, watcher_data);
+
+  Coolio_Watcher_setup(watcher, &watcher_data->watcher);
+
+  return watcher;
+}
+
+static size_t Coolio_StatWatcher_memsize(const void *data)
+{
+  return sizeof(struct Coolio_Watcher_stat);
+}
+
 /**
  *  call-seq:
  *    Coolio::StatWatcher.initialize(path, interval = 0) -> Coolio::StatWatcher
@@ -93,12 +122,12 @@ static VALUE Coolio_StatWatcher_initialize(int argc, VALUE *argv, VALUE self)
 
   watcher_data->dispatch_callback = Coolio_StatWatcher_dispatch_callback;
   ev_stat_init(
-      &watcher_data->event_types.ev_stat,
+      Coolio_Watcher_ev(watcher_data, stat),
       Coolio_StatWatcher_libev_callback,
       RSTRING_PTR(path),
       interval == Qnil ? 0 : NUM2DBL(interval)
   );
-  watcher_data->event_types.ev_stat.data = (void *)self;
+  Coolio_Watcher_ev(watcher_data, stat)->data = (void *)self;
 
   return Qnil;
 }
@@ -127,7 +156,7 @@ static VALUE Coolio_StatWatcher_attach(VALUE self, VALUE loop)
 
   watcher_data->loop = loop;
 
-  ev_stat_start(loop_data->ev_loop, &watcher_data->event_types.ev_stat);
+  ev_stat_start(loop_data->ev_loop, Coolio_Watcher_ev(watcher_data, stat));
 	rb_call_super(1, &loop);
 
   return self;
@@ -208,8 +237,8 @@ static void Coolio_StatWatcher_dispatch_callback(VALUE self, int revents)
   struct Coolio_Watcher *watcher_data;
   watcher_data = Coolio_Watcher_ptr(self);
 
-  VALUE previous_statdata = Coolio_StatInfo_build(&watcher_data->event_types.ev_stat.prev);
-  VALUE current_statdata = Coolio_StatInfo_build(&watcher_data->event_types.ev_stat.attr);
+  VALUE previous_statdata = Coolio_StatInfo_build(&Coolio_Watcher_ev(watcher_data, stat)->prev);
+  VALUE current_statdata = Coolio_StatInfo_build(&Coolio_Watcher_ev(watcher_data, stat)->attr);
   rb_funcall(self, rb_intern("on_change"), 2, previous_statdata, current_statdata);
 }
 
@@ -15,6 +15,9 @@ static VALUE cCoolio_Watcher = Qnil;
 static VALUE cCoolio_TimerWatcher = Qnil;
 static VALUE cCoolio_Loop = Qnil;
 
+static VALUE Coolio_TimerWatcher_allocate(VALUE klass);
+static size_t Coolio_TimerWatcher_memsize(const void *data);
+
 static VALUE Coolio_TimerWatcher_initialize(int argc, VALUE *argv, VALUE self);
 static VALUE Coolio_TimerWatcher_attach(VALUE self, VALUE loop);
 static VALUE Coolio_TimerWatcher_detach(VALUE self);
@@ -36,6 +39,7 @@ void Init_coolio_timer_watcher()
   mCoolio = rb_define_module("Coolio");
   cCoolio_Watcher = rb_define_class_under(mCoolio, "Watcher", rb_cObject);
   cCoolio_TimerWatcher = rb_define_class_under(mCoolio, "TimerWatcher", cCoolio_Watcher);
+  rb_define_alloc_func(cCoolio_TimerWatcher, Coolio_TimerWatcher_allocate);
   cCoolio_Loop = rb_define_class_under(mCoolio, "Loop", rb_cObject);
 
   rb_define_method(cCoolio_TimerWatcher, "initialize", Coolio_TimerWatcher_initialize, -1);
@@ -47,6 +51,31 @@ void Init_coolio_timer_watcher()
   rb_define_method(cCoolio_TimerWatcher, "on_timer", Coolio_TimerWatcher_on_timer, 0);
 }
 
+static const rb_data_type_t Coolio_TimerWatcher_type = {
+  "Coolio::TimerWatcher",
+  {
+    Coolio_Watcher_mark,
+    RUBY_DEFAULT_FREE,
+    Coolio_TimerWatcher_memsize,
+  },
+  &Coolio_Watcher_type,
+};
+
+static VALUE Coolio_TimerWatcher_allocate(VALUE klass)
+{
+  struct Coolio_Watcher_timer *watcher_data;
+  VALUE watcher = TypedData_Make_Struct(klass, struct Coolio_Watcher_timer, &Coolio_TimerWatcher_type, watcher_data);
+
+  Coolio_Watcher_setup(watcher, &watcher_data->watcher);
+
+  return watcher;
+}
+
+static size_t Coolio_TimerWatcher_memsize(const void *data)
+{
+  return sizeof(struct Coolio_Watcher_timer);
+}
+
 /**
  *  call-seq:
  *    Coolio::TimerWatcher.initialize(interval, repeating = false) -> Coolio::TimerWatcher
@@ -72,12 +101,12 @@ static VALUE Coolio_TimerWatcher_initialize(int argc, VALUE *argv, VALUE self)
 
   watcher_data->dispatch_callback = Coolio_TimerWatcher_dispatch_callback;
   ev_timer_init(
-      &watcher_data->event_types.ev_timer, 
+      Coolio_Watcher_ev(watcher_data, timer), 
       Coolio_TimerWatcher_libev_callback, 
       NUM2DBL(interval), 
       repeating == Qtrue ? NUM2DBL(interval) : 0
   );  
-  watcher_data->event_types.ev_timer.data = (void *)self;
+  Coolio_Watcher_ev(watcher_data, timer)->data = (void *)self;
 
   return Qnil;
 }
@@ -111,12 +140,12 @@ static VALUE Coolio_TimerWatcher_attach(VALUE self, VALUE loop)
   timeout = interval + ev_time() - ev_now(loop_data->ev_loop);
   
   ev_timer_set(
-    &watcher_data->event_types.ev_timer, 
+    Coolio_Watcher_ev(watcher_data, timer), 
     timeout, 
     rb_iv_get(self, "@repeating") == Qtrue ? interval : 0
   );
 
-  ev_timer_start(loop_data->ev_loop, &watcher_data->event_types.ev_timer);
+  ev_timer_start(loop_data->ev_loop, Coolio_Watcher_ev(watcher_data, timer));
 	rb_call_super(1, &loop);
 
   return self;  
@@ -187,7 +216,7 @@ static VALUE Coolio_TimerWatcher_reset(VALUE self)
 
   loop_data = Coolio_Loop_ptr(watcher_data->loop);
 
-  ev_timer_again(loop_data->ev_loop, &watcher_data->event_types.ev_timer);
+  ev_timer_again(loop_data->ev_loop, Coolio_Watcher_ev(watcher_data, timer));
 
   return self;
 }
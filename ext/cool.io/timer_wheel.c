@@ -0,0 +1,583 @@
+/*
+ * Copyright (C) 2007-10 Tony Arcieri
+ * You may redistribute this under the terms of the Ruby license.
+ * See LICENSE for details
+ */
+
+#include "ruby.h"
+#include <math.h>
+
+#include "ev_wrap.h"
+
+#include "cool.io.h"
+#include "watcher.h"
+
+/* Timeouts are capped at this many ticks, which never come around anyway,
+ * so tick counts can't overflow */
+#define COOLIO_TIMERWHEEL_MAX_TICKS 4e12
+
+static VALUE mCoolio = Qnil;
+static VALUE cCoolio_Watcher = Qnil;
+static VALUE cCoolio_TimerWheel = Qnil;
+static VALUE cCoolio_Loop = Qnil;
+
+static VALUE Coolio_TimerWheel_allocate(VALUE klass);
+static void Coolio_TimerWheel_mark(void *data);
+static void Coolio_TimerWheel_free(void *data);
+static size_t Coolio_TimerWheel_memsize(const void *data);
+
+static VALUE Coolio_TimerWheel_initialize(int argc, VALUE *argv, VALUE self);
+static VALUE Coolio_TimerWheel_attach(VALUE self, VALUE loop);
+static VALUE Coolio_TimerWheel_detach(VALUE self);
+static VALUE Coolio_TimerWheel_enable(VALUE self);
+static VALUE Coolio_TimerWheel_disable(VALUE self);
+static VALUE Coolio_TimerWheel_add(VALUE self, VALUE object, VALUE timeout);
+static VALUE Coolio_TimerWheel_remove(VALUE self, VALUE object);
+static VALUE Coolio_TimerWheel_include(VALUE self, VALUE object);
+static VALUE Coolio_TimerWheel_size(VALUE self);
+static VALUE Coolio_TimerWheel_resolution(VALUE self);
+static VALUE Coolio_TimerWheel_on_timeout(VALUE self, VALUE object);
+
+static struct Coolio_TimerWheel *Coolio_TimerWheel_ptr(VALUE self);
+static void Coolio_TimerWheel_start(struct Coolio_TimerWheel *wheel);
+static void Coolio_TimerWheel_link(struct Coolio_TimerWheel *wheel, struct Coolio_TimerWheel_entry *entry);
+static void Coolio_TimerWheel_unlink(struct Coolio_TimerWheel *wheel, struct Coolio_TimerWheel_entry *entry);
+static VALUE Coolio_TimerWheel_advance(struct Coolio_TimerWheel *wheel);
+static VALUE Coolio_TimerWheel_dispatch_expired(VALUE data);
+static VALUE Coolio_TimerWheel_requeue_expired(VALUE data);
+
+static void Coolio_TimerWheel_libev_callback(struct ev_loop *ev_loop, struct ev_timer *timer, int revents);
+static void Coolio_TimerWheel_dispatch_callback(VALUE self, int revents);
+
+/*
+ * Coolio::TimerWheel keeps timeouts for any number of objects, calling
+ * on_timeout(object) once an object's timeout has passed.  Unlike a
+ * TimerWatcher per object, adding, re-adding and removing an object are
+ * constant time and allocate no Ruby objects, and the whole wheel is
+ * driven by a single libev timer which ticks every resolution seconds
+ * while any timeouts are pending.  Timeouts fire at most one resolution
+ * late, and everything expiring on the same tick is dispatched together.
+ *
+ * Objects are told apart by identity.  Timeouts don't advance while the
+ * wheel is disabled or detached.  Ticks are counted on a monotonic clock,
+ * so changes to the time of day don't make timeouts fire early.
+ */
+void Init_coolio_timer_wheel()
+{
+  mCoolio = rb_define_module("Coolio");
+  cCoolio_Watcher = rb_define_class_under(mCoolio, "Watcher", rb_cObject);
+  cCoolio_TimerWheel = rb_define_class_under(mCoolio, "TimerWheel", cCoolio_Watcher);
+  rb_define_alloc_func(cCoolio_TimerWheel, Coolio_TimerWheel_allocate);
+  cCoolio_Loop = rb_define_class_under(mCoolio, "Loop", rb_cObject);
+
+  rb_define_method(cCoolio_TimerWheel, "initialize", Coolio_TimerWheel_initialize, -1);
+  rb_define_method(cCoolio_TimerWheel, "attach", Coolio_TimerWheel_attach, 1);
+  rb_define_method(cCoolio_TimerWheel, "detach", Coolio_TimerWheel_detach, 0);
+  rb_define_method(cCoolio_TimerWheel, "enable", Coolio_TimerWheel_enable, 0);
+  rb_define_method(cCoolio_TimerWheel, "disable", Coolio_TimerWheel_disable, 0);
+  rb_define_method(cCoolio_TimerWheel, "add", Coolio_TimerWheel_add, 2);
+  rb_define_method(cCoolio_TimerWheel, "remove", Coolio_TimerWheel_remove, 1);
+  rb_define_method(cCoolio_TimerWheel, "include?", Coolio_TimerWheel_include, 1);
+  rb_define_method(cCoolio_TimerWheel, "size", Coolio_TimerWheel_size, 0);
+  rb_define_method(cCoolio_TimerWheel, "resolution", Coolio_TimerWheel_resolution, 0);
+  rb_define_method(cCoolio_TimerWheel, "on_timeout", Coolio_TimerWheel_on_timeout, 1);
+}
+
+static const rb_data_type_t Coolio_TimerWheel_type = {
+  "Coolio::TimerWheel",
+  {
+    Coolio_TimerWheel_mark,
+    Coolio_TimerWheel_free,
+    Coolio_TimerWheel_memsize,
+  },
+  &Coolio_Watcher_type,
+};
+
+static VALUE Coolio_TimerWheel_allocate(VALUE klass)
+{
+  struct Coolio_TimerWheel *wheel;
+  VALUE watcher = TypedData_Make_Struct(klass, struct Coolio_TimerWheel, &Coolio_TimerWheel_type, wheel);
+
+  Coolio_Watcher_setup(watcher, &wheel->watcher);
+  wheel->entries = st_init_numtable();
+
+  return watcher;
+}
+
+static void Coolio_TimerWheel_mark(void *data)
+{
+  struct Coolio_TimerWheel *wheel = (struct Coolio_TimerWheel *)data;
+  struct Coolio_TimerWheel_entry *entry;
+  size_t i;
+
+  Coolio_Watcher_mark(data);
+
+  /* Objects are pinned, they're the keys of the entry table.  Expired
+   * entries are marked through the array they're being dispatched from */
+  for(i = 0; i < wheel->slot_count; i++)
+    for(entry = wheel->slots[i]; entry; entry = entry->next)
+      rb_gc_mark(entry->object);
+}
+
+static int Coolio_TimerWheel_free_expired(st_data_t key, st_data_t value, st_data_t arg)
+{
+  struct Coolio_TimerWheel_entry *entry = (struct Coolio_TimerWheel_entry *)value;
+
+  if(entry->linked == COOLIO_TIMERWHEEL_EXPIRED)
+    xfree(entry);
+
+  return ST_CONTINUE;
+}
+
+static void Coolio_TimerWheel_free(void *data)
+{
+  struct Coolio_TimerWheel *wheel = (struct Coolio_TimerWheel *)data;
+  struct Coolio_TimerWheel_entry *entry, *next;
+  size_t i;
+
+  for(i = 0; i < wheel->slot_count; i++)
+    for(entry = wheel->slots[i]; entry; entry = next) {
+      next = entry->next;
+      xfree(entry);
+    }
+
+  /* Expired entries are only reachable through the table */
+  st_foreach(wheel->entries, Coolio_TimerWheel_free_expired, 0);
+
+  if(wheel->slots)
+    xfree(wheel->slots);
+
+  st_free_table(wheel->entries);
+  xfree(wheel);
+}
+
+static size_t Coolio_TimerWheel_memsize(const void *data)
+{
+  const struct Coolio_TimerWheel *wheel = (const struct Coolio_TimerWheel *)data;
+
+  return sizeof(struct Coolio_TimerWheel) +
+    wheel->slot_count * sizeof(struct Coolio_TimerWheel_entry *) +
+    wheel->size * sizeof(struct Coolio_TimerWheel_entry) +
+    st_memsize(wheel->entries);
+}
+
+static struct Coolio_TimerWheel *Coolio_TimerWheel_ptr(VALUE self)
+{
+  return (struct Coolio_TimerWheel *)Coolio_Watcher_ptr(self);
+}
+
+/**
+ *  call-seq:
+ *    Coolio::TimerWheel.initialize(resolution = 0.1, slots = 512) -> Coolio::TimerWheel
+ *
+ * Create a new Coolio::TimerWheel which ticks every resolution seconds.
+ * Timeouts up to resolution * slots seconds away are visited once, longer
+ * ones once more per turn of the wheel.  slots is rounded up to a power
+ * of two.
+ */
+static VALUE Coolio_TimerWheel_initialize(int argc, VALUE *argv, VALUE self)
+{
+  VALUE resolution, slots;
+  struct Coolio_TimerWheel *wheel;
+  long slot_count;
+
+  rb_scan_args(argc, argv, "02", &resolution, &slots);
+
+  wheel = Coolio_TimerWheel_ptr(self);
+  wheel->resolution = resolution == Qnil ? 0.1 : NUM2DBL(resolution);
+  slot_count = slots == Qnil ? 512 : NUM2LONG(slots);
+
+  if(wheel->resolution <= 0)
+    rb_raise(rb_eArgError, "resolution must be positive");
+
+  if(slot_count <= 0 || slot_count > (1L << 24))
+    rb_raise(rb_eArgError, "invalid number of slots (%ld)", slot_count);
+
+  if(wheel->slots)
+    rb_raise(rb_eRuntimeError, "already initialized");
+
+  for(wheel->slot_count = 1; wheel->slot_count < (size_t)slot_count; wheel->slot_count <<= 1);
+  wheel->slots = ALLOC_N(struct Coolio_TimerWheel_entry *, wheel->slot_count);
+  MEMZERO(wheel->slots, struct Coolio_TimerWheel_entry *, wheel->slot_count);
+
+  wheel->watcher.dispatch_callback = Coolio_TimerWheel_dispatch_callback;
+  ev_timer_init(&wheel->ev_timer, Coolio_TimerWheel_libev_callback, 0, wheel->resolution);
+  wheel->ev_timer.data = (void *)self;
+
+  return Qnil;
+}
+
+/* Start ticking from now, if there's anything to time out */
+static void Coolio_TimerWheel_start(struct Coolio_TimerWheel *wheel)
+{
+  struct ev_loop *ev_loop = Coolio_Loop_ptr(wheel->watcher.loop)->ev_loop;
+
+  if(wheel->size == 0 || ev_is_active(&wheel->ev_timer))
+    return;
+
+  wheel->tick_time = Coolio_Loop_clock();
+  ev_timer_again(ev_loop, &wheel->ev_timer);
+}
+
+/**
+ *  call-seq:
+ *    Coolio::TimerWheel.attach(loop) -> Coolio::TimerWheel
+ *
+ * Attach the timer wheel to the given Coolio::Loop.  If the wheel is already
+ * attached to a loop, detach it from the old one and attach it to the new one.
+ */
+static VALUE Coolio_TimerWheel_attach(VALUE self, VALUE loop)
+{
+  struct Coolio_TimerWheel *wheel;
+
+  if(!rb_obj_is_kind_of(loop, cCoolio_Loop))
+    rb_raise(rb_eArgError, "expected loop to be an instance of Coolio::Loop, not %s", RSTRING_PTR(rb_inspect(loop)));
+
+  wheel = Coolio_TimerWheel_ptr(self);
+
+  if(wheel->watcher.loop != Qnil)
+    Coolio_TimerWheel_detach(self);
+
+  wheel->watcher.loop = loop;
+  Coolio_TimerWheel_start(wheel);
+  rb_call_super(1, &loop);
+
+  return self;
+}
+
+/**
+ *  call-seq:
+ *    Coolio::TimerWheel.detach -> Coolio::TimerWheel
+ *
+ * Detach the timer wheel from its current Coolio::Loop.
+ */
+static VALUE Coolio_TimerWheel_detach(VALUE self)
+{
+  Watcher_Detach(timer, self);
+
+  return self;
+}
+
+/**
+ *  call-seq:
+ *    Coolio::TimerWheel.enable -> Coolio::TimerWheel
+ *
+ * Re-enable a timer wheel which has been temporarily disabled.  See the
+ * disable method for a more thorough explanation.
+ */
+static VALUE Coolio_TimerWheel_enable(VALUE self)
+{
+  struct Coolio_TimerWheel *wheel = Coolio_TimerWheel_ptr(self);
+
+  if(wheel->watcher.loop == Qnil)
+    rb_raise(rb_eRuntimeError, "not attached to a loop");
+
+  rb_call_super(0, 0);
+  Coolio_TimerWheel_start(wheel);
+
+  return self;
+}
+
+/**
+ *  call-seq:
+ *    Coolio::TimerWheel.disable -> Coolio::TimerWheel
+ *
+ * Temporarily disable a timer wheel which is attached to a loop.  Pending
+ * timeouts are kept, but don't advance until it's enabled again.
+ */
+static VALUE Coolio_TimerWheel_disable(VALUE self)
+{
+  Watcher_Disable(timer, self);
+
+  return self;
+}
+
+/* Add an entry to the slot of the tick it expires on */
+static void Coolio_TimerWheel_link(struct Coolio_TimerWheel *wheel, struct Coolio_TimerWheel_entry *entry)
+{
+  struct Coolio_TimerWheel_entry **slot = &wheel->slots[entry->expires & (wheel->slot_count - 1)];
+
+  entry->linked = entry->expires;
+
+  entry->prev = 0;
+  entry->next = *slot;
+  if(*slot)
+    (*slot)->prev = entry;
+  *slot = entry;
+}
+
+static void Coolio_TimerWheel_unlink(struct Coolio_TimerWheel *wheel, struct Coolio_TimerWheel_entry *entry)
+{
+  if(entry->linked == COOLIO_TIMERWHEEL_EXPIRED)
+    return;
+
+  if(entry->prev)
+    entry->prev->next = entry->next;
+  else
+    wheel->slots[entry->linked & (wheel->slot_count - 1)] = entry->next;
+
+  if(entry->next)
+    entry->next->prev = entry->prev;
+}
+
+/**
+ *  call-seq:
+ *    Coolio::TimerWheel#add(object, timeout) -> Coolio::TimerWheel
+ *
+ * Call on_timeout(object) timeout seconds from now.  If the object already
+ * has a timeout pending, it's replaced.
+ */
+static VALUE Coolio_TimerWheel_add(VALUE self, VALUE object, VALUE timeout)
+{
+  struct Coolio_TimerWheel *wheel = Coolio_TimerWheel_ptr(self);
+  struct Coolio_TimerWheel_entry *entry;
+  st_data_t data;
+  double seconds = NUM2DBL(timeout), ticks;
+  uint64_t expires;
+
+  if(wheel->watcher.loop == Qnil)
+    rb_raise(rb_eRuntimeError, "not attached to a loop");
+
+  if(!isfinite(seconds))
+    rb_raise(rb_eArgError, "timeout must be finite");
+
+  if(seconds < 0)
+    rb_raise(rb_eArgError, "timeout must not be negative");
+
+  /* Count from the last tick, so the timeout never fires early */
+  ticks = ceil((Coolio_Loop_clock() - wheel->tick_time + seconds) / wheel->resolution);
+
+  if(!ev_is_active(&wheel->ev_timer))
+    ticks = ceil(seconds / wheel->resolution);
+
+  /* Keep huge timeouts representable, they'll never fire either way */
+  if(ticks > COOLIO_TIMERWHEEL_MAX_TICKS)
+    ticks = COOLIO_TIMERWHEEL_MAX_TICKS;
+
+  expires = wheel->tick + (ticks < 1 ? 1 : (uint64_t)ticks);
+
+  if(st_lookup(wheel->entries, (st_data_t)object, &data)) {
+    entry = (struct Coolio_TimerWheel_entry *)data;
+
+    /* Pushing a timeout back, by far the most common case, leaves the
+     * entry where it is until its slot comes up.  An expired entry being
+     * added again before its on_timeout goes back into a slot */
+    if(expires >= entry->linked && entry->linked != COOLIO_TIMERWHEEL_EXPIRED) {
+      entry->expires = expires;
+      goto started;
+    }
+
+    Coolio_TimerWheel_unlink(wheel, entry);
+  } else {
+    entry = ALLOC(struct Coolio_TimerWheel_entry);
+    entry->object = object;
+    st_insert(wheel->entries, (st_data_t)object, (st_data_t)entry);
+    wheel->size++;
+  }
+
+  entry->expires = expires;
+  Coolio_TimerWheel_link(wheel, entry);
+
+started:
+
+  if(wheel->watcher.enabled)
+    Coolio_TimerWheel_start(wheel);
+
+  return self;
+}
+
+/**
+ *  call-seq:
+ *    Coolio::TimerWheel#remove(object) -> true or false
+ *
+ * Cancel the object's pending timeout.  Returns whether it had one.
+ */
+static VALUE Coolio_TimerWheel_remove(VALUE self, VALUE object)
+{
+  struct Coolio_TimerWheel *wheel = Coolio_TimerWheel_ptr(self);
+  st_data_t key = (st_data_t)object, data;
+
+  if(!st_delete(wheel->entries, &key, &data))
+    return Qfalse;
+
+  Coolio_TimerWheel_unlink(wheel, (struct Coolio_TimerWheel_entry *)data);
+  xfree((void *)data);
+  wheel->size--;
+
+  return Qtrue;
+}
+
+/**
+ *  call-seq:
+ *    Coolio::TimerWheel#include?(object) -> true or false
+ *
+ * Does the object have a timeout pending?
+ */
+static VALUE Coolio_TimerWheel_include(VALUE self, VALUE object)
+{
+  return st_lookup(Coolio_TimerWheel_ptr(self)->entries, (st_data_t)object, 0) ? Qtrue : Qfalse;
+}
+
+/**
+ *  call-seq:
+ *    Coolio::TimerWheel#size -> Integer
+ *
+ * Number of pending timeouts
+ */
+static VALUE Coolio_TimerWheel_size(VALUE self)
+{
+  return SIZET2NUM(Coolio_TimerWheel_ptr(self)->size);
+}
+
+/**
+ *  call-seq:
+ *    Coolio::TimerWheel#resolution -> Float
+ *
+ * Seconds between ticks of the wheel
+ */
+static VALUE Coolio_TimerWheel_resolution(VALUE self)
+{
+  return rb_float_new(Coolio_TimerWheel_ptr(self)->resolution);
+}
+
+/**
+ *  call-seq:
+ *    Coolio::TimerWheel#on_timeout(object) -> nil
+ *
+ * Called for each object whose timeout has passed.  The object has been
+ * removed from the wheel by then, so it may be added again.
+ */
+static VALUE Coolio_TimerWheel_on_timeout(VALUE self, VALUE object)
+{
+  return Qnil;
+}
+
+/* Turn the wheel up to the current time, returning what expired.  Expired
+ * entries stay in the table, out of any slot, until they're dispatched */
+static VALUE Coolio_TimerWheel_advance(struct Coolio_TimerWheel *wheel)
+{
+  struct Coolio_TimerWheel_entry *entry, *next;
+  VALUE expired = rb_ary_new();
+  double now = Coolio_Loop_clock();
+  uint64_t ticks, steps, target, i;
+
+  /* Never count backwards, however the clock got behind the wheel */
+  if(now <= wheel->tick_time)
+    return expired;
+
+  /* libev may wake us up a hair before the tick is due */
+  ticks = (uint64_t)((now - wheel->tick_time) / wheel->resolution + 0.0001);
+  if(ticks == 0)
+    return expired;
+
+  /* Going around once visits every slot, however late we are */
+  target = wheel->tick + ticks;
+  steps = ticks < wheel->slot_count ? ticks : wheel->slot_count;
+
+  for(i = 1; i <= steps; i++) {
+    for(entry = wheel->slots[(wheel->tick + i) & (wheel->slot_count - 1)]; entry; entry = next) {
+      next = entry->next;
+
+      if(entry->expires > target) {
+        /* Its timeout was pushed back since it was put in this slot */
+        if(entry->linked != entry->expires) {
+          Coolio_TimerWheel_unlink(wheel, entry);
+          Coolio_TimerWheel_link(wheel, entry);
+        }
+        continue;
+      }
+
+      Coolio_TimerWheel_unlink(wheel, entry);
+      entry->linked = COOLIO_TIMERWHEEL_EXPIRED;
+      rb_ary_push(expired, entry->object);
+    }
+  }
+
+  wheel->tick = target;
+  wheel->tick_time += ticks * wheel->resolution;
+
+  return expired;
+}
+
+/* Expired objects being dispatched, and how far dispatching got */
+struct Coolio_TimerWheel_dispatch
+{
+  VALUE self;
+  VALUE expired;
+  long next;
+};
+
+/* Take each expired entry off the wheel right before its on_timeout, so
+ * objects removed or added again by an earlier callback are skipped */
+static VALUE Coolio_TimerWheel_dispatch_expired(VALUE data)
+{
+  struct Coolio_TimerWheel_dispatch *dispatch = (struct Coolio_TimerWheel_dispatch *)data;
+  struct Coolio_TimerWheel *wheel = Coolio_TimerWheel_ptr(dispatch->self);
+  VALUE object;
+  st_data_t key, entry;
+
+  while(dispatch->next < RARRAY_LEN(dispatch->expired)) {
+    object = RARRAY_AREF(dispatch->expired, dispatch->next++);
+    key = (st_data_t)object;
+
+    if(!st_lookup(wheel->entries, key, &entry) ||
+        ((struct Coolio_TimerWheel_entry *)entry)->linked != COOLIO_TIMERWHEEL_EXPIRED)
+      continue;
+
+    st_delete(wheel->entries, &key, 0);
+    xfree((void *)entry);
+    wheel->size--;
+
+    rb_funcall(dispatch->self, rb_intern("on_timeout"), 1, object);
+  }
+
+  return Qnil;
+}
+
+/* Should an on_timeout raise, the objects after it fire on the next tick */
+static VALUE Coolio_TimerWheel_requeue_expired(VALUE data)
+{
+  struct Coolio_TimerWheel_dispatch *dispatch = (struct Coolio_TimerWheel_dispatch *)data;
+  struct Coolio_TimerWheel *wheel = Coolio_TimerWheel_ptr(dispatch->self);
+  struct Coolio_TimerWheel_entry *entry;
+  st_data_t value;
+
+  for(; dispatch->next < RARRAY_LEN(dispatch->expired); dispatch->next++) {
+    if(!st_lookup(wheel->entries, (st_data_t)RARRAY_AREF(dispatch->expired, dispatch->next), &value))
+      continue;
+
+    entry = (struct Coolio_TimerWheel_entry *)value;
+    if(entry->linked != COOLIO_TIMERWHEEL_EXPIRED)
+      continue;
+
+    entry->expires = wheel->tick + 1;
+    Coolio_TimerWheel_link(wheel, entry);
+  }
+
+  /* Don't keep waking up for an empty wheel */
+  if(wheel->size == 0 && wheel->watcher.loop != Qnil)
+    ev_timer_stop(Coolio_Loop_ptr(wheel->watcher.loop)->ev_loop, &wheel->ev_timer);
+
+  return Qnil;
+}
+
+/* libev callback */
+static void Coolio_TimerWheel_libev_callback(struct ev_loop *ev_loop, struct ev_timer *timer, int revents)
+{
+  Coolio_Loop_process_event((VALUE)timer->data, revents);
+}
+
+/* Coolio::Loop dispatch callback */
+static void Coolio_TimerWheel_dispatch_callback(VALUE self, int revents)
+{
+  struct Coolio_TimerWheel_dispatch dispatch;
+
+  if(!(revents & EV_TIMEOUT))
+    rb_raise(rb_eRuntimeError, "unknown revents value for ev_timer: %d", revents);
+
+  dispatch.self = self;
+  dispatch.expired = Coolio_TimerWheel_advance(Coolio_TimerWheel_ptr(self));
+  dispatch.next = 0;
+
+  rb_ensure(Coolio_TimerWheel_dispatch_expired, (VALUE)&dispatch, Coolio_TimerWheel_requeue_expired, (VALUE)&dispatch);
+}
@@ -13,7 +13,7 @@ static VALUE mCoolio = Qnil;
 static VALUE cCoolio_Watcher = Qnil;
 
 static VALUE Coolio_Watcher_allocate(VALUE klass);
-static void Coolio_Watcher_mark(void *data);
+static size_t Coolio_Watcher_memsize(const void *data);
 
 static VALUE Coolio_Watcher_initialize(VALUE self);
 static VALUE Coolio_Watcher_attach(VALUE self, VALUE loop);
@@ -52,11 +52,12 @@ void Init_coolio_watcher()
   rb_define_method(cCoolio_Watcher, "enabled?", Coolio_Watcher_enabled, 0);
 }
 
-static const rb_data_type_t Coolio_Watcher_type = {
+const rb_data_type_t Coolio_Watcher_type = {
   "Coolio::Watcher",
   {
     Coolio_Watcher_mark,
     RUBY_DEFAULT_FREE,
+    Coolio_Watcher_memsize,
   },
 };
 
@@ -73,13 +74,27 @@ static VALUE Coolio_Watcher_allocate(VALUE klass)
   struct Coolio_Watcher *watcher_data;
   VALUE watcher = TypedData_Make_Struct(klass, struct Coolio_Watcher, &Coolio_Watcher_type, watcher_data);
 
+  Coolio_Watcher_setup(watcher, watcher_data);
+
+  return watcher;
+}
+
+/* Initialize the common header of a newly allocated watcher of any type */
+void Coolio_Watcher_setup(VALUE watcher, struct Coolio_Watcher *watcher_data)
+{
   watcher_data->loop = Qnil;
+  watcher_data->self = watcher;
   watcher_data->enabled = 0;
+  watcher_data->prev = watcher_data->next = 0;
+  watcher_data->pending_index = -1;
+}
 
-  return watcher;
+static size_t Coolio_Watcher_memsize(const void *data)
+{
+  return sizeof(struct Coolio_Watcher);
 }
 
-static void Coolio_Watcher_mark(void *data)
+void Coolio_Watcher_mark(void *data)
 {
   struct Coolio_Watcher *watcher_data = data;
 
@@ -101,33 +116,27 @@ static VALUE Coolio_Watcher_initialize(VALUE self)
  */
 static VALUE Coolio_Watcher_attach(VALUE self, VALUE loop)
 {
-  VALUE loop_watchers, active_watchers;
   struct Coolio_Watcher *watcher_data;
+  struct Coolio_Loop *loop_data;
 
   watcher_data = Coolio_Watcher_ptr(self);
   watcher_data->enabled = 1;
-    
-  loop_watchers = rb_iv_get(loop, "@watchers");
-
-  if(loop_watchers == Qnil) {
-    /* we should never get here */
-    loop_watchers = rb_hash_new();
-    rb_iv_set(loop, "@watchers", loop_watchers);
-  }
-
-  /* Add us to the loop's array of active watchers.  This is mainly done
-   * to keep the VM from garbage collecting watchers that are associated
-   * with a loop (and also lets you see within Ruby which watchers are
-   * associated with a given loop), but isn't really necessary for any 
-   * other reason */
-  rb_hash_aset(loop_watchers, self, Qtrue);
-
-  active_watchers = rb_iv_get(loop, "@active_watchers");
-  if(active_watchers == Qnil)
-    active_watchers = INT2NUM(1);
-  else
-    active_watchers = INT2NUM(NUM2INT(active_watchers) + 1);
-  rb_iv_set(loop, "@active_watchers", active_watchers);
+
+  loop_data = Coolio_Loop_ptr(loop);
+
+  /* Add us to the loop's registry of attached watchers.  This is mainly
+   * done to keep the VM from garbage collecting watchers that are
+   * associated with a loop (the loop marks everything in its registry),
+   * and also lets you see within Ruby which watchers are associated with
+   * a given loop.  Linking through the watcher itself keeps this O(1) */
+  watcher_data->prev = 0;
+  watcher_data->next = loop_data->watchers_head;
+  if(loop_data->watchers_head)
+    loop_data->watchers_head->prev = watcher_data;
+  loop_data->watchers_head = watcher_data;
+
+  loop_data->watcher_count++;
+  loop_data->active_watchers++;
 
   return self;
 }
@@ -142,7 +151,6 @@ static VALUE Coolio_Watcher_detach(VALUE self)
 {
   struct Coolio_Watcher *watcher_data;
   struct Coolio_Loop *loop_data;
-  VALUE loop_watchers;
   int i;
 
   watcher_data = Coolio_Watcher_ptr(self);
@@ -150,35 +158,33 @@ static VALUE Coolio_Watcher_detach(VALUE self)
   if(watcher_data->loop == Qnil)
     rb_raise(rb_eRuntimeError, "not attached to a loop");
 
-  loop_watchers = rb_iv_get(watcher_data->loop, "@watchers");
+  loop_data = Coolio_Loop_ptr(watcher_data->loop);
 
-  /* Remove us from the loop's array of active watchers.  This likely
-   * has negative performance and scalability characteristics as this
-   * isn't an O(1) operation.  Hopefully there's a better way...
-   * Trying a hash for now... */
-  rb_hash_delete(loop_watchers, self);
+  /* Unlink us from the loop's registry of attached watchers */
+  if(watcher_data->prev)
+    watcher_data->prev->next = watcher_data->next;
+  else
+    loop_data->watchers_head = watcher_data->next;
+  if(watcher_data->next)
+    watcher_data->next->prev = watcher_data->prev;
+  watcher_data->prev = watcher_data->next = 0;
 
-  if(watcher_data->enabled) {
-    rb_iv_set(
-        watcher_data->loop, 
-        "@active_watchers",
-        INT2NUM(NUM2INT(rb_iv_get(watcher_data->loop, "@active_watchers")) - 1)
-    );
-  }
+  loop_data->watcher_count--;
+  if(watcher_data->enabled)
+    loop_data->active_watchers--;
 
   watcher_data->enabled = 0;
 
-  loop_data = Coolio_Loop_ptr(watcher_data->loop);
-
-  /* Iterate through the events in the loop's event buffer.  If there
-   * are any pending events from this watcher, mark them NULL.  The
-   * dispatch loop will skip them.  This prevents watchers earlier
-   * in the event buffer from detaching others which may have pending
-   * events in the buffer but get garbage collected in the meantime */
-  for(i = 0; i < loop_data->events_received; i++) {
-    if(loop_data->eventbuf[i].watcher == self)
-      loop_data->eventbuf[i].watcher = Qnil;
-  }
+  /* If there is a pending event from this watcher in the loop's event
+   * buffer, mark it NULL.  The dispatch loop will skip it.  This prevents
+   * watchers earlier in the event buffer from detaching others which may
+   * have pending events in the buffer but get garbage collected in the
+   * meantime.  A watcher has at most one pending event, and it remembers
+   * where that is, so there is no need to scan the buffer */
+  i = watcher_data->pending_index;
+  if(i >= 0 && i < loop_data->events_received && loop_data->eventbuf[i].watcher == self)
+    loop_data->eventbuf[i].watcher = Qnil;
+  watcher_data->pending_index = -1;
 
   watcher_data->loop = Qnil;
 
@@ -201,12 +207,7 @@ static VALUE Coolio_Watcher_enable(VALUE self)
     rb_raise(rb_eRuntimeError, "already enabled");
 
   watcher_data->enabled = 1;
-
-  rb_iv_set(
-      watcher_data->loop, 
-      "@active_watchers",
-      INT2NUM(NUM2INT(rb_iv_get(watcher_data->loop, "@active_watchers")) + 1)
-  );
+  Coolio_Loop_ptr(watcher_data->loop)->active_watchers++;
 
   return self;
 }
@@ -227,12 +228,7 @@ static VALUE Coolio_Watcher_disable(VALUE self)
     rb_raise(rb_eRuntimeError, "already disabled");
 
   watcher_data->enabled = 0;
-
-  rb_iv_set(
-      watcher_data->loop, 
-      "@active_watchers",
-      INT2NUM(NUM2INT(rb_iv_get(watcher_data->loop, "@active_watchers")) - 1)
-  );
+  Coolio_Loop_ptr(watcher_data->loop)->active_watchers--;
 
   return self;
 }
@@ -21,7 +21,7 @@
     detach_func(watcher); \
   \
   watcher_data->loop = loop; \
-  ev_##watcher_type##_start(loop_data->ev_loop, &watcher_data->event_types.ev_##watcher_type); \
+  ev_##watcher_type##_start(loop_data->ev_loop, Coolio_Watcher_ev(watcher_data, watcher_type)); \
   rb_call_super(1, &loop)
 
 #define Watcher_Detach(watcher_type, watcher) \
@@ -50,7 +50,7 @@
   \
   loop_data = Coolio_Loop_ptr(watcher_data->loop); \
   \
-  ev_##watcher_type##_start(loop_data->ev_loop, &watcher_data->event_types.ev_##watcher_type)
+  ev_##watcher_type##_start(loop_data->ev_loop, Coolio_Watcher_ev(watcher_data, watcher_type))
 
 #define Watcher_Disable(watcher_type, watcher) \
   struct Coolio_Watcher *watcher_data; \
@@ -63,7 +63,7 @@
   \
   if (watcher_data->enabled) { \
     loop_data = Coolio_Loop_ptr(watcher_data->loop); \
-    ev_##watcher_type##_stop(loop_data->ev_loop, &watcher_data->event_types.ev_##watcher_type); \
+    ev_##watcher_type##_stop(loop_data->ev_loop, Coolio_Watcher_ev(watcher_data, watcher_type)); \
   } \
   rb_call_super(0, 0);
 
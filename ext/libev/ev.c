@@ -3573,6 +3573,7 @@ time_update (EV_P_ ev_tstamp max_block)
 struct ev_poll_args {
   struct ev_loop *loop;
   ev_tstamp waittime;
+  ev_tstamp sleeptime; /* io_blocktime sleep, taken without the GVL too */
 };
 
 static
@@ -3580,6 +3581,13 @@ VALUE ev_backend_poll(void *ptr)
 {
   struct ev_poll_args *args = (struct ev_poll_args *)ptr;
   struct ev_loop *loop = args->loop;
+  if (args->sleeptime > 0.)
+    {
+      /* let the release/acquire callbacks see the sleep as blocking too */
+      EV_RELEASE_CB;
+      ev_sleep (args->sleeptime);
+      EV_ACQUIRE_CB;
+    }
   backend_poll (EV_A_ args->waittime);
   return Qnil;
 }
@@ -3702,7 +3710,14 @@ ev_run (EV_P_ int flags)
 
                 if (expect_true (sleeptime > 0.))
                   {
+/* ########## COOLIO PATCHERY HO! ########## */
+/* sleeping here would hold the GVL, ev_backend_poll sleeps instead */
+#if !defined(HAVE_RB_THREAD_BLOCKING_REGION) && !defined(HAVE_RB_THREAD_CALL_WITHOUT_GVL)
+                    EV_RELEASE_CB;
                     ev_sleep (sleeptime);
+                    EV_ACQUIRE_CB;
+#endif
+/* ######################################## */
                     waittime -= sleeptime;
                   }
               }
@@ -3768,6 +3783,7 @@ rb_thread_unsafe_dangerous_crazy_blocking_region_end(...);
 #if defined(HAVE_RB_THREAD_BLOCKING_REGION) || defined(HAVE_RB_THREAD_CALL_WITHOUT_GVL)
         poll_args.loop = loop;
         poll_args.waittime = waittime;
+        poll_args.sleeptime = sleeptime;
         rb_thread_call_without_gvl((void *)ev_backend_poll, (void *)&poll_args, RUBY_UBF_IO, 0);
 #else
          backend_poll (EV_A_ waittime);
@@ -14,6 +14,14 @@ require "cool.io/io"
 require "cool.io/iowatcher"
 require "cool.io/timer_watcher"
 require "cool.io/async_watcher"
+require "cool.io/native_async_watcher"
+require "cool.io/idle_watcher"
+require "cool.io/prepare_watcher"
+require "cool.io/check_watcher"
+require "cool.io/signal_watcher"
+require "cool.io/child_watcher"
+require "cool.io/periodic_watcher"
+require "cool.io/timer_wheel"
 require "cool.io/listener"
 require "cool.io/dns_resolver"
 require "cool.io/socket"
@@ -22,53 +22,60 @@ module Coolio
     def initialize(io)
       @_io = io
       @_write_buffer  ||= ::Coolio::Buffer.new
-      @_read_watcher  = Watcher.new(io, self, :r)
-      @_write_watcher = Watcher.new(io, self, :w)
+      @_watcher       = Watcher.new(io, self, :r)
+      @_watcher.read_buffer = @_read_buffer if @_read_buffer
+      @_watcher.inactivity_timeout = @_inactivity_timeout if @_inactivity_timeout
     end
 
     #
-    # Watcher methods, delegated to @_read_watcher
+    # Watcher methods.  A single watcher handles both reading and writing,
+    # these control whether the IO object is being read from
     #
 
     # Attach to the event loop
     def attach(loop)
-      @_read_watcher.attach(loop)
-      schedule_write if !@_write_buffer.empty?
+      @_watcher.events = @_write_buffer.empty? ? :r : :rw
+      @_watcher.attach(loop)
       self
     end
 
     # Detach from the event loop
     def detach
-      # TODO should these detect write buffers, as well?
-      @_read_watcher.detach
+      @_watcher.detach
       self
     end
 
     # Enable the watcher
     def enable
-      @_read_watcher.enable
+      raise RuntimeError, "not attached to a loop" unless attached?
+      raise RuntimeError, "already enabled" if enabled?
+
+      update_watcher(true, writing?)
       self
     end
 
     # Disable the watcher
     def disable
-      @_read_watcher.disable
+      raise RuntimeError, "not attached to a loop" unless attached?
+      raise RuntimeError, "already disabled" unless enabled?
+
+      update_watcher(false, writing?)
       self
     end
 
     # Is the watcher attached?
     def attached?
-      @_read_watcher.attached?
+      @_watcher.attached?
     end
 
     # Is the watcher enabled?
     def enabled?
-      @_read_watcher.enabled?
+      reading?
     end
 
     # Obtain the event loop associated with this object
     def evloop
-      @_read_watcher.evloop
+      @_watcher.evloop
     end
 
     #
@@ -87,21 +94,84 @@ module Coolio
     def on_close; end
     event_callback :on_close
 
+    # Called when the inactivity timeout passes without reads or writes
+    def on_inactivity_timeout; end
+    event_callback :on_inactivity_timeout
+
     #
     # Write interface
     #
 
     # Write data in a buffered, non-blocking manner
     def write(data)
+      direct = @_direct_write && @_write_buffer.empty?
       @_write_buffer << data
-      schedule_write
+      direct ? write_direct : schedule_write
       data.size
     end
 
+    # Enable or disable direct writes.  With direct writes enabled, #write
+    # on an empty write buffer immediately tries a non-blocking write to
+    # the IO object, and only buffers whatever could not be written and
+    # waits for writability when the IO object would block.  This saves
+    # a loop iteration per write for connections which are usually
+    # writable, such as request/response protocols.
+    #
+    # Note that with direct writes on_write_complete (and on_close when
+    # the write fails) may be called from within #write.
+    def direct_write=(enabled)
+      @_direct_write = enabled
+    end
+
+    # Are direct writes enabled?
+    def direct_write?
+      @_direct_write ? true : false
+    end
+
+    # Enable or disable reusing one receive buffer.  With a reused buffer
+    # every call to on_read is passed the same String, which is only valid
+    # until on_read returns: its contents are replaced by the next read.
+    # Callbacks which need to hold on to the data must copy it (or parse
+    # it out) before returning.  This avoids allocating a String per read
+    # for connections which consume data as soon as it arrives.
+    #
+    # Loops created with :reuse_read_buffer share one such String among
+    # all their connections.  It may be enabled before DNS resolution
+    # completes.
+    def reuse_read_buffer=(enabled)
+      @_read_buffer = enabled ? String.new : nil
+      @_watcher.read_buffer = @_read_buffer if @_watcher
+    end
+
+    # Is a reused receive buffer passed to on_read?
+    def reuse_read_buffer?
+      @_read_buffer || (@_watcher && evloop && evloop.read_buffer) ? true : false
+    end
+
+    # Call on_inactivity_timeout whenever the given number of seconds pass
+    # without the IO object becoming readable or writable, e.g. to close
+    # idle connections.  This is tracked by the watcher natively, so reads
+    # and writes don't need to reset a timer.  nil or 0 remove the timeout.
+    # It may be set before DNS resolution completes.
+    def inactivity_timeout=(seconds)
+      if @_watcher
+        @_watcher.inactivity_timeout = seconds
+      elsif seconds and seconds < 0
+        raise ArgumentError, "inactivity timeout must not be negative"
+      end
+
+      @_inactivity_timeout = seconds
+    end
+
+    # Seconds of inactivity before on_inactivity_timeout is called, if any
+    def inactivity_timeout
+      return @_watcher.inactivity_timeout if @_watcher
+      @_inactivity_timeout.to_f if @_inactivity_timeout and @_inactivity_timeout > 0
+    end
+
     # Close the IO stream
     def close
       detach if attached?
-      detach_write_watcher
       @_io.close unless closed?
 
       on_close
@@ -120,7 +190,7 @@ module Coolio
     # Read from the input buffer and dispatch to on_read
     def on_readable
       begin
-        on_read @_io.read_nonblock(INPUT_SIZE)
+        on_read @_io.read_nonblock(INPUT_SIZE, read_buffer)
       rescue Errno::EAGAIN, Errno::EINTR
         return
 
@@ -130,6 +200,11 @@ module Coolio
       end
     end
 
+    # String reused to receive data, if any
+    def read_buffer
+      @_read_buffer || @_watcher.evloop.read_buffer
+    end
+
     # Write the contents of the output buffer
     def on_writable
       begin
@@ -148,10 +223,33 @@ module Coolio
       end
     end
 
+    # Write the buffer out immediately, waiting for writability only if
+    # the IO object would block
+    def write_direct
+      return schedule_write unless @_io and @_watcher.attached?
+
+      begin
+        @_write_buffer.write_to(@_io)
+        @_watcher.touch
+      rescue Errno::EINTR
+        return schedule_write
+
+      # SystemCallError catches Errno::EPIPE & Errno::ECONNRESET amongst others.
+      rescue SystemCallError, IOError, SocketError
+        return close
+      end
+
+      if @_write_buffer.empty?
+        on_write_complete
+      else
+        schedule_write
+      end
+    end
+
     # Schedule a write to be performed when the IO object becomes writable
     def schedule_write
       return unless @_io # this would mean 'we are still pre DNS here'
-      return unless @_read_watcher.attached? # this would mean 'currently unattached' -- ie still pre DNS, or just plain not attached, which is ok
+      return unless @_watcher.attached? # this would mean 'currently unattached' -- ie still pre DNS, or just plain not attached, which is ok
       begin
         enable_write_watcher
       rescue IOError
@@ -159,19 +257,31 @@ module Coolio
     end
 
     def enable_write_watcher
-      if @_write_watcher.attached?
-        @_write_watcher.enable unless @_write_watcher.enabled?
-      else
-        @_write_watcher.attach(evloop)
-      end
+      update_watcher(reading?, true) unless writing?
     end
 
     def disable_write_watcher
-      @_write_watcher.disable if @_write_watcher and @_write_watcher.enabled?
+      update_watcher(reading?, false) if writing?
     end
 
-    def detach_write_watcher
-      @_write_watcher.detach if @_write_watcher and @_write_watcher.attached?
+    # Is the watcher waiting for the IO object to become readable?
+    def reading?
+      @_watcher.enabled? and @_watcher.events != :w
+    end
+
+    # Is the watcher waiting for the IO object to become writable?
+    def writing?
+      @_watcher.enabled? and @_watcher.events != :r
+    end
+
+    # Change what the watcher is interested in without a second watcher
+    def update_watcher(reading, writing)
+      if reading or writing
+        @_watcher.events = reading ? (writing ? :rw : :r) : :w
+        @_watcher.enable unless @_watcher.enabled?
+      else
+        @_watcher.disable if @_watcher.enabled?
+      end
     end
 
     # Internal class implementing watchers used by Coolio::IO
@@ -179,6 +289,10 @@ module Coolio
       def initialize(ruby_io, coolio_io, flags)
         @coolio_io = coolio_io
         super(ruby_io, flags)
+
+        # Plain IO objects are read natively and handed straight to on_read,
+        # which spares exceptions on EAGAIN/EOF and INPUT_SIZE sized Strings
+        self.read_target = coolio_io if native_read?(ruby_io)
       end
 
       # Configure IOWatcher event callbacks to call the method passed to #initialize
@@ -189,6 +303,21 @@ module Coolio
       def on_writable
         @coolio_io.__send__(:on_writable)
       end
+
+      def on_inactivity_timeout
+        @coolio_io.__send__(:on_inactivity_timeout)
+      end
+
+      public :read_buffer=
+
+      private
+
+      # Native reads bypass Coolio::IO#on_readable and anything in between
+      # the file descriptor and the caller, such as SSL
+      def native_read?(ruby_io)
+        return false if RUBY_PLATFORM =~ /mingw|mswin/
+        ::IO === ruby_io and @coolio_io.method(:on_readable).owner == Coolio::IO
+      end
     end
   end
 end
@@ -11,8 +11,29 @@ module Coolio
   # connection it fires the on_connection event with the newly accepted
   # socket as a parameter.
   class Listener < IOWatcher
+    # Default maximum number of connections accepted per readiness event
+    DEFAULT_ACCEPT_BUDGET = 64
+
+    # Maximum number of connections accepted each time the listen socket
+    # becomes readable.  Pending connections beyond it are accepted on the
+    # next loop iteration, so other watchers get their turn during
+    # connection storms.
+    attr_reader :accept_budget
+
+    # Set the maximum number of connections accepted per readiness event.
+    # It must be at least 1, or the loop would spin without accepting.
+    def accept_budget=(budget)
+      raise ArgumentError, "accept budget must be at least 1" unless Integer === budget and budget >= 1
+      @accept_budget = budget
+    end
+
     def initialize(listen_socket)
       @listen_socket = listen_socket
+      @accept_budget = DEFAULT_ACCEPT_BUDGET
+      @accepted_class = case listen_socket
+                        when ::TCPServer  then ::TCPSocket
+                        when ::UNIXServer then ::UNIXSocket
+                        end
       super(@listen_socket)
     end
 
@@ -42,6 +63,18 @@ module Coolio
     # Coolio callback for handling new connections
     unless RUBY_PLATFORM =~ /mingw|mswin/
       def on_readable
+        # Drain the backlog natively, without an exception per empty accept
+        if @accepted_class
+          sockets = accept_batch(@accept_budget, @accepted_class)
+          begin
+            on_connection sockets.shift until sockets.empty?
+          ensure
+            # Don't leak the rest of the batch when on_connection raises
+            sockets.each(&:close)
+          end
+          return
+        end
+
         begin
           on_connection @listen_socket.accept_nonblock
         rescue Errno::EAGAIN, Errno::ECONNABORTED
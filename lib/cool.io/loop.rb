@@ -38,10 +38,19 @@ module Coolio
     #     :kqueue (BSD/Mac OS X)
     #     :port   (Solaris 10)
     #
+    # :reuse_read_buffer (boolean)
+    #   Pass the same String to the on_read of every Coolio::IO on this
+    #   loop, see Coolio::IO#reuse_read_buffer=
+    #
+    # :io_collect_interval (seconds)
+    #   Wait this long between polls to handle more I/O events at once,
+    #   see #io_collect_interval=
+    #
+    # :timeout_collect_interval (seconds)
+    #   Let timers fire this late to handle more of them at once, see
+    #   #timeout_collect_interval=
+    #
     def initialize(options = {})
-      @watchers = {}
-      @active_watchers = 0
-
       flags = 0
 
       options.each do |option, value|
@@ -62,6 +71,12 @@ module Coolio
             else raise ArgumentError, "no such backend: #{backend}"
             end
           end
+        when :reuse_read_buffer
+          self.read_buffer = String.new if value
+        when :io_collect_interval
+          self.io_collect_interval = value
+        when :timeout_collect_interval
+          self.timeout_collect_interval = value
         else raise ArgumentError, "no such option: #{option}"
         end
       end
@@ -74,38 +89,6 @@ module Coolio
       watcher.attach self
     end
 
-    # Run the event loop and dispatch events back to Ruby.  If there
-    # are no watchers associated with the event loop it will return
-    # immediately.  Otherwise, run will continue blocking and making
-    # event callbacks to watchers until all watchers associated with
-    # the loop have been disabled or detached.  The loop may be
-    # explicitly stopped by calling the stop method on the loop object.
-    def run(timeout = nil)
-      raise RuntimeError, "no watchers for this loop" if @watchers.empty?
-
-      @running = true
-      while @running and not @active_watchers.zero?
-        run_once(timeout)
-      end
-      @running = false
-    end
-
-    # Stop the event loop if it's running
-    def stop
-      raise RuntimeError, "loop not running" unless @running
-      @running = false
-    end
-
-    # Does the loop have any active watchers?
-    def has_active_watchers?
-      @active_watchers > 0
-    end
-
-    # All watchers attached to the current loop
-    def watchers
-      @watchers.keys
-    end
-
     #######
     private
     #######
@@ -0,0 +1,45 @@
+require File.expand_path('../spec_helper', __FILE__)
+
+describe Cool.io::ChildWatcher, :env => :exclude_win do
+  let :loop do
+    Cool.io::Loop.new
+  end
+
+  it "reports the exit status of the child" do
+    pid = fork { exit!(3) }
+    exits = []
+
+    watcher = Cool.io::ChildWatcher.new(pid)
+    watcher.on_exit { |exited, status| exits << [exited, status.exitstatus] }
+    watcher.attach(loop)
+    loop.run
+
+    expect(exits).to eq([[pid, 3]])
+    expect(watcher.attached?).to eq(false)
+  end
+
+  it "reports children which exited before it was attached" do
+    pid = fork { exit!(0) }
+    sleep 0.05
+    exits = []
+
+    watcher = Cool.io::ChildWatcher.new(pid)
+    watcher.on_exit { |exited, status| exits << exited }
+    watcher.attach(loop)
+    loop.run
+
+    expect(exits).to eq([pid])
+  end
+
+  it "leaves other children for Process.wait" do
+    other = fork { exit!(5) }
+    pid = fork { sleep 0.1; exit!(0) }
+
+    watcher = Cool.io::ChildWatcher.new(pid)
+    watcher.attach(loop)
+    loop.run
+
+    _, status = Process.waitpid2(other)
+    expect(status.exitstatus).to eq(5)
+  end
+end
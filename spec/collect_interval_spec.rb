@@ -0,0 +1,53 @@
+require File.expand_path('../spec_helper', __FILE__)
+
+describe Cool.io::Loop do
+  context "collect intervals" do
+    it "defaults to polling and firing timers as soon as possible" do
+      loop = Cool.io::Loop.new
+      expect(loop.io_collect_interval).to eq(0.0)
+      expect(loop.timeout_collect_interval).to eq(0.0)
+    end
+
+    it "takes them as options and through setters" do
+      loop = Cool.io::Loop.new(:io_collect_interval => 0.001, :timeout_collect_interval => 0.01)
+      expect(loop.io_collect_interval).to eq(0.001)
+      expect(loop.timeout_collect_interval).to eq(0.01)
+
+      loop.io_collect_interval = 0.002
+      loop.timeout_collect_interval = nil
+      expect(loop.io_collect_interval).to eq(0.002)
+      expect(loop.timeout_collect_interval).to eq(0.0)
+
+      expect { loop.io_collect_interval = -1 }.to raise_error(ArgumentError)
+    end
+
+    it "lets other threads run while collecting events" do
+      loop = Cool.io::Loop.new(:io_collect_interval => 0.2)
+      timer = Cool.io::TimerWatcher.new(0.3, true).attach(loop)
+      thread = Thread.new { 3.times { loop.run_once } }
+
+      longest = 0
+      last = Process.clock_gettime(Process::CLOCK_MONOTONIC)
+      while thread.alive?
+        now = Process.clock_gettime(Process::CLOCK_MONOTONIC)
+        longest = now - last if now - last > longest
+        last = now
+      end
+      thread.join
+      timer.detach
+
+      expect(longest).to be < 0.1
+    end
+
+    it "still dispatches timers" do
+      loop = Cool.io::Loop.new(:timeout_collect_interval => 0.01)
+      fired = false
+      timer = Cool.io::TimerWatcher.new(0.01)
+      timer.on_timer { fired = true; timer.detach }
+      timer.attach(loop)
+      loop.run
+
+      expect(fired).to eq(true)
+    end
+  end
+end
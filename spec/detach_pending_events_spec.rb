@@ -0,0 +1,69 @@
+require 'spec_helper'
+
+describe Cool.io::Loop do
+  class PendingVictim < Cool.io::IOWatcher
+    attr_reader :reads
+
+    def initialize(io, &block)
+      super(io)
+      @io = io
+      @reads = 0
+      @block = block
+    end
+
+    def on_readable
+      @reads += 1
+      @io.read_nonblock(1024) rescue nil
+      @block.call(self) if @block
+    end
+  end
+
+  def pending_watchers(loop, count, &block)
+    count.times.map do
+      r, w = IO.pipe
+      w.write("x")
+      @pipes << r << w
+      PendingVictim.new(r, &block).attach(loop)
+    end
+  end
+
+  before { @pipes = [] }
+  after { @pipes.each { |io| io.close unless io.closed? } }
+
+  it "skips pending events of watchers detached earlier in the same round" do
+    loop = Cool.io::Loop.new
+    watchers = nil
+    watchers = pending_watchers(loop, 64) do |fired|
+      (watchers - [fired]).each { |w| w.detach if w.attached? }
+    end
+
+    expect(loop.run_once).to eq(64)
+    expect(watchers.map(&:reads).inject(:+)).to eq(1)
+    expect(loop.watchers.size).to eq(1)
+  end
+
+  it "does not dispatch stale events to watchers reattached in the same round" do
+    loop = Cool.io::Loop.new
+    watchers = nil
+    watchers = pending_watchers(loop, 16) do |fired|
+      (watchers - [fired]).each { |w| w.detach.attach(loop) }
+    end
+
+    expect(loop.run_once).to eq(16)
+    expect(watchers.map(&:reads).inject(:+)).to eq(1)
+    expect(loop.watchers.size).to eq(16)
+  end
+
+  it "survives garbage collection of watchers detached with events pending" do
+    loop = Cool.io::Loop.new
+    watchers = nil
+    watchers = pending_watchers(loop, 64) do |fired|
+      (watchers - [fired]).each { |w| w.detach if w.attached? }
+      watchers = [fired]
+      GC.start
+    end
+
+    expect { loop.run_once }.not_to raise_error
+    expect(loop.watchers.size).to eq(1)
+  end
+end
@@ -21,6 +21,12 @@ describe Cool.io::Buffer do
     expect(buffer.append "baz").to eq "baz"
     expect(buffer.to_str).to eq "foobarbaz"
   end
+
+  it "prepends empty strings to empty buffers" do
+    expect(buffer.prepend "").to eq ""
+    expect(buffer.size).to eq 0
+    expect(buffer.to_str).to eq ""
+  end
   
   context "#read" do
     it "can be used to retrieve the contents of a buffer" do
@@ -114,6 +120,35 @@ describe Cool.io::Buffer do
           expect(@receiver.recvfrom_nonblock(3)[0]).to eq "foo"
         end
       end
+
+      context "using a pipe", :env => :exclude_win do
+        before :each do
+          @reader, @writer = IO.pipe
+        end
+        after :each do
+          @reader.close
+          @writer.close
+        end
+
+        it "resumes from the middle of a node after a partial write" do
+          data = (0...200_000).map { |i| (i % 251).chr }.join
+          buffer << data
+
+          # Shift node boundaries away from the pipe's capacity
+          expect(buffer.read(1000)).to eq data.slice!(0, 1000)
+          written = buffer.write_to @writer
+          expect(written < data.size).to eq true
+          expect(buffer.size).to eq data.size - written
+
+          received = ""
+          until buffer.empty?
+            received << @reader.read_nonblock(1 << 20)
+            buffer.write_to @writer
+          end
+          received << @reader.read_nonblock(1 << 20) while received.size < data.size
+          expect(received).to eq data
+        end
+      end
     end
   end
   
@@ -144,4 +179,187 @@ describe Cool.io::Buffer do
     end
   end
 
+  context "#read_until" do
+    it "reads up to and including a multi-byte delimiter" do
+      buffer << "GET / HTTP/1.1\r\nHost: example.com\r\n\r\nbody"
+      expect(buffer.read_until "\r\n\r\n").to eq "GET / HTTP/1.1\r\nHost: example.com\r\n\r\n"
+      expect(buffer.to_str).to eq "body"
+    end
+
+    it "leaves incomplete frames in the buffer" do
+      buffer << "PING\r"
+      expect(buffer.read_until "\r\n").to eq nil
+      expect(buffer.to_str).to eq "PING\r"
+
+      buffer << "\n"
+      expect(buffer.read_until "\r\n", true).to eq "PING"
+      expect(buffer.empty?).to eq true
+      expect { buffer.read_until "" }.to raise_error(ArgumentError)
+    end
+
+    it "finds delimiters spanning nodes" do
+      small = Cool.io::Buffer.new(7)
+      small << "abcdef\r"
+      small << "\n\r"
+      small << "\nxyz"
+      expect(small.read_until "\r\n\r\n").to eq "abcdef\r\n\r\n"
+      expect(small.to_str).to eq "xyz"
+    end
+  end
+
+  context "#each_frame" do
+    it "yields every complete frame" do
+      lines = (1..100).map { |i| "line #{i} " + "x" * (i % 37) }
+      buffer << lines.join("\r\n") + "\r\npartial"
+
+      frames = []
+      expect(buffer.each_frame("\r\n", true) { |frame| frames << frame }).to eq 100
+      expect(frames).to eq lines
+      expect(buffer.to_str).to eq "partial"
+    end
+  end
+
+  context "mixed node sizes" do
+    it "keeps data in order across small and full sized nodes" do
+      expected = ""
+      200.times do |i|
+        chunk = i.to_s * (i % 7 + 1)
+        buffer << chunk
+        expected << chunk
+      end
+      buffer << "y" * 40000
+      buffer.prepend "z" * 20000
+      expected = "z" * 20000 + expected + "y" * 40000
+
+      expect(buffer.size).to eq expected.size
+      expect(buffer.to_str).to eq expected
+      expect(buffer.read(30000)).to eq expected[0, 30000]
+      expect(buffer.read).to eq expected[30000..-1]
+    end
+  end
+
+  context "frozen strings" do
+    it "can have empty strings prepended" do
+      payload = ("0123456789" * 10000).freeze
+      buffer << payload
+      expect(buffer.prepend "").to eq ""
+      expect(buffer.size).to eq payload.size
+      expect(buffer.to_str).to eq payload
+    end
+
+    it "are written out without being copied into the buffer" do
+      payload = ("0123456789" * 10000).freeze
+      GC.start
+      allocated = Cool.io::Buffer.pool_stats[:allocated]
+
+      buffer << "head"
+      buffer << payload
+      buffer << "tail"
+      expect(Cool.io::Buffer.pool_stats[:allocated]).to eq allocated + 3
+
+      GC.start
+      GC.compact if GC.respond_to?(:compact)
+
+      expect(buffer.read(10)).to eq "head012345"
+      expected = payload[6..-1] + "tail"
+      expect(buffer.size).to eq expected.size
+
+      reader, writer = UNIXSocket.pair
+      written = ""
+      while written.size < expected.size
+        buffer.write_to writer
+        written << reader.readpartial(1 << 20)
+      end
+
+      expect(written).to eq expected
+      expect(Cool.io::Buffer.pool_stats[:allocated]).to eq allocated
+      reader.close
+      writer.close
+    end
+  end
+
+  context "moving data between buffers" do
+    let :other do
+      Cool.io::Buffer.new
+    end
+
+    it "transfers whole nodes and splits the boundary one" do
+      data = (0...50000).map { |i| (i % 251).chr }.join
+      buffer << data
+      other << "x"
+
+      expect(buffer.transfer_to(other, 20000)).to eq 20000
+      expect(buffer.size).to eq 30000
+      expect(other.to_str).to eq "x" + data[0, 20000]
+
+      expect(buffer.transfer_to(other)).to eq 30000
+      expect(buffer.empty?).to eq true
+      expect(other.to_str).to eq "x" + data
+      expect { buffer.transfer_to(buffer) }.to raise_error(ArgumentError)
+    end
+
+    it "appends another buffer, leaving it empty" do
+      buffer << "foo"
+      other << "bar" * 10000
+
+      expect(buffer.append_buffer(other)).to eq 30000
+      expect(other.empty?).to eq true
+      expect(buffer.to_str).to eq "foo" + "bar" * 10000
+
+      other << "baz"
+      expect(other.to_str).to eq "baz"
+    end
+
+    it "splits off the front of a buffer" do
+      payload = ("0123456789" * 5000).freeze
+      buffer << "head"
+      buffer << payload
+      buffer << "tail"
+
+      front = buffer.split(25004)
+      expect(front).to be_a Cool.io::Buffer
+      expect(front.to_str).to eq "head" + payload[0, 25000]
+      expect(buffer.to_str).to eq payload[25000..-1] + "tail"
+
+      front << "more"
+      expect(front.read).to eq "head" + payload[0, 25000] + "more"
+      expect(buffer.read).to eq payload[25000..-1] + "tail"
+    end
+  end
+
+  context "node pool" do
+    it "shares freed nodes between buffers" do
+      GC.start
+      allocated = Cool.io::Buffer.pool_stats[:allocated]
+
+      buffer << "x" * 40000
+      expect(Cool.io::Buffer.pool_stats[:allocated]).to eq allocated + 3
+
+      buffer.clear
+      stats = Cool.io::Buffer.pool_stats
+      expect(stats[:allocated]).to eq allocated
+      expect(stats[:cached]).to be >= 3
+      expect(stats[:peak]).to be >= allocated + 3
+
+      other = Cool.io::Buffer.new
+      other << "y" * 20000
+      expect(Cool.io::Buffer.pool_stats[:slabs]).to eq stats[:slabs]
+      other.clear
+    end
+
+    it "keeps no more empty slabs than it's allowed to retain" do
+      retain = Cool.io::Buffer.pool_retain
+      begin
+        buffers = 64.times.map { b = Cool.io::Buffer.new; b << "x" * 16384; b }
+        buffers.each(&:clear)
+        expect(Cool.io::Buffer.pool_stats[:empty_bytes]).to be <= retain
+
+        Cool.io::Buffer.pool_retain = 0
+        expect(Cool.io::Buffer.pool_stats[:empty_bytes]).to eq 0
+      ensure
+        Cool.io::Buffer.pool_retain = retain
+      end
+    end
+  end
+
 end
@@ -0,0 +1,53 @@
+require File.expand_path('../spec_helper', __FILE__)
+
+describe "Coolio::PrepareWatcher, Coolio::CheckWatcher and Coolio::IdleWatcher" do
+  let :loop do
+    Cool.io::Loop.new
+  end
+
+  before :each do
+    @reader, @writer = IO.pipe
+    @calls = []
+  end
+
+  after :each do
+    @reader.close
+    @writer.close
+  end
+
+  def io_watcher
+    watcher = Cool.io::IOWatcher.new(@reader)
+    watcher.on_readable { @calls << :io; @reader.read_nonblock(1) }
+    watcher
+  end
+
+  it "calls prepare and check watchers around the other callbacks" do
+    check = Cool.io::CheckWatcher.new
+    check.on_check { @calls << :check }
+    prepare = Cool.io::PrepareWatcher.new
+    prepare.on_prepare { @calls << :prepare }
+
+    loop.attach check
+    loop.attach io_watcher
+    loop.attach prepare
+
+    @writer.write "x"
+    loop.run_once
+    expect(@calls).to eq [:prepare, :io, :check]
+  end
+
+  it "calls idle watchers only when there is nothing else to do" do
+    idle = Cool.io::IdleWatcher.new
+    idle.on_idle { @calls << :idle }
+
+    loop.attach io_watcher
+    loop.attach idle
+
+    @writer.write "x"
+    loop.run_once
+    expect(@calls).to eq [:io]
+
+    loop.run_once
+    expect(@calls).to eq [:io, :idle]
+  end
+end
@@ -0,0 +1,85 @@
+require File.expand_path('../spec_helper', __FILE__)
+
+describe Cool.io::Loop do
+  let :loop do
+    Cool.io::Loop.new
+  end
+
+  context "#post" do
+    it "runs blocks posted from other threads on the loop's thread" do
+      timer = Cool.io::TimerWatcher.new(10).attach(loop)
+      results = []
+
+      producers = 4.times.map do |n|
+        Thread.new do
+          25.times { |i| loop.post { results << [n, i, Thread.current] } }
+        end
+      end
+      producers.each(&:join)
+
+      expect(loop.pending_posts).to eq(100)
+      loop.run_once
+      expect(loop.pending_posts).to eq(0)
+
+      expect(results.size).to eq(100)
+      expect(results.map(&:last).uniq).to eq([Thread.current])
+      4.times do |n|
+        expect(results.select { |r| r[0] == n }.map { |r| r[1] }).to eq((0...25).to_a)
+      end
+
+      timer.detach
+    end
+
+    it "wakes up a loop waiting for events" do
+      timer = Cool.io::TimerWatcher.new(10).attach(loop)
+      posted = false
+
+      thread = Thread.new { sleep 0.01; loop.post { posted = true; loop.stop } }
+      loop.run
+      thread.join
+
+      expect(posted).to eq(true)
+      timer.detach
+    end
+
+    it "requires a block and queues nothing without one" do
+      expect { loop.post }.to raise_error(ArgumentError)
+      expect(loop.pending_posts).to eq(0)
+    end
+
+    it "keeps blocks queued behind one which raised" do
+      timer = Cool.io::TimerWatcher.new(10).attach(loop)
+      ran = []
+
+      loop.post { ran << 1 }
+      loop.post { raise "boom" }
+      loop.post { ran << 3 }
+
+      expect { loop.run_once }.to raise_error(RuntimeError)
+      expect(ran).to eq([1])
+      expect(loop.pending_posts).to eq(1)
+
+      started = Time.now
+      loop.run_once(1)
+      expect(Time.now - started).to be < 0.5
+      expect(ran).to eq([1, 3])
+      expect(loop.pending_posts).to eq(0)
+      timer.detach
+    end
+
+    it "runs blocks posted after one raised along with the leftovers" do
+      timer = Cool.io::TimerWatcher.new(10).attach(loop)
+      ran = []
+
+      loop.post { raise "boom" }
+      loop.post { ran << 2 }
+      expect { loop.run_once }.to raise_error(RuntimeError)
+
+      loop.post { ran << 3 }
+      loop.run_once(1)
+      expect(ran).to eq([2, 3])
+      expect(loop.pending_posts).to eq(0)
+      timer.detach
+    end
+  end
+end
@@ -0,0 +1,57 @@
+require File.expand_path('../spec_helper', __FILE__)
+
+describe Cool.io::Loop do
+  context "#stats" do
+    let :loop do
+      Cool.io::Loop.new
+    end
+
+    it "starts out empty" do
+      stats = loop.stats
+      expect(stats[:iterations]).to eq(0)
+      expect(stats[:wakeups]).to eq(0)
+      expect(stats[:events]).to eq(0)
+      expect(stats[:events_per_wakeup].values.inject(:+)).to eq(0)
+      expect(stats[:poll_time]).to eq(0.0)
+    end
+
+    it "counts the io collect interval as time spent polling" do
+      collecting = Cool.io::Loop.new(:io_collect_interval => 0.1)
+      timer = Cool.io::TimerWatcher.new(0.15, true).attach(collecting)
+
+      started = Process.clock_gettime(Process::CLOCK_MONOTONIC)
+      3.times { collecting.run_once }
+      elapsed = Process.clock_gettime(Process::CLOCK_MONOTONIC) - started
+      timer.detach
+
+      expect(collecting.stats[:poll_time]).to be >= elapsed * 0.8
+    end
+
+    it "counts wakeups, events and where the time went" do
+      reader, writer = IO.pipe
+      watchers = 3.times.map do
+        watcher = Cool.io::IOWatcher.new(reader, 'r')
+        watcher.on_readable { sleep 0.01 }
+        watcher.attach(loop)
+      end
+
+      loop.run_once(0.05)
+      writer.write "x"
+      loop.run_once
+
+      stats = loop.stats
+      expect(stats[:iterations]).to eq(2)
+      expect(stats[:wakeups]).to eq(2)
+      expect(stats[:events]).to eq(3)
+      expect(stats[:events_per_wakeup][0]).to eq(1)
+      expect(stats[:events_per_wakeup][2]).to eq(1)
+      expect(stats[:eventbuf_high_water]).to eq(3)
+      expect(stats[:poll_time]).to be >= 0.04
+      expect(stats[:dispatch_time]).to be >= 0.03
+
+      watchers.each(&:detach)
+      reader.close
+      writer.close
+    end
+  end
+end
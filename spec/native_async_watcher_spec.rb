@@ -0,0 +1,39 @@
+require File.expand_path('../spec_helper', __FILE__)
+
+describe Cool.io::NativeAsyncWatcher do
+  let :loop do
+    Cool.io::Loop.new
+  end
+
+  it "wakes up the loop from another thread" do
+    signals = 0
+    watcher = Cool.io::NativeAsyncWatcher.new
+    watcher.on_signal { signals += 1; watcher.detach }
+    watcher.attach(loop)
+
+    thread = Thread.new { sleep 0.01; watcher.signal }
+    loop.run
+    thread.join
+
+    expect(signals).to eq(1)
+  end
+
+  it "coalesces signals sent before the loop dispatches them" do
+    signals = 0
+    watcher = Cool.io::NativeAsyncWatcher.new
+    watcher.on_signal { signals += 1 }
+    watcher.attach(loop)
+
+    100.times { watcher.signal }
+    loop.run_once
+    expect(signals).to eq(1)
+
+    expect(loop.run_once(0.01)).to eq(0)
+    expect(signals).to eq(1)
+  end
+
+  it "ignores signals while not attached" do
+    watcher = Cool.io::NativeAsyncWatcher.new
+    expect(watcher.signal).to eq(watcher)
+  end
+end
@@ -0,0 +1,67 @@
+require File.expand_path('../spec_helper', __FILE__)
+
+describe Cool.io::PeriodicWatcher do
+  let :loop do
+    Cool.io::Loop.new
+  end
+
+  it "fires on multiples of its interval" do
+    watcher = Cool.io::PeriodicWatcher.new(0.05)
+    fired_at = nil
+    watcher.on_timer { fired_at = Time.now.to_f; watcher.detach }
+    watcher.attach(loop)
+
+    at = watcher.at
+    expect((at / 0.05).round * 0.05).to be_within(0.0001).of(at)
+    loop.run
+
+    expect(fired_at).to be >= at
+  end
+
+  it "fires once at an absolute time with no interval" do
+    at = Time.now.to_f + 0.02
+    watcher = Cool.io::PeriodicWatcher.new(0, at)
+    fired = 0
+    watcher.on_timer { fired += 1 }
+    watcher.attach(loop)
+    loop.run
+
+    expect(fired).to eq(1)
+    expect(watcher.attached?).to eq(false)
+    expect(Time.now.to_f).to be >= at
+  end
+
+  it "asks a reschedule block when to fire next" do
+    times = []
+    watcher = Cool.io::PeriodicWatcher.new { |now| times << now; now + 0.01 }
+    fired = 0
+    watcher.on_timer { fired += 1; watcher.detach if fired == 3 }
+    watcher.attach(loop)
+    loop.run
+
+    expect(fired).to eq(3)
+    expect(times.size).to be >= 3
+  end
+
+  it "raises errors from the reschedule block" do
+    watcher = Cool.io::PeriodicWatcher.new { |now| raise "no more" }
+    expect { watcher.attach(loop) }.to raise_error(RuntimeError, "no more")
+    watcher.detach
+  end
+
+  it "rejects reschedule blocks returning non-finite times" do
+    [Float::NAN, Float::INFINITY].each do |at|
+      watcher = Cool.io::PeriodicWatcher.new { |now| at }
+      expect { watcher.attach(loop) }.to raise_error(ArgumentError)
+      watcher.detach
+    end
+  end
+
+  it "raises non-finite reschedule times from the loop" do
+    calls = 0
+    watcher = Cool.io::PeriodicWatcher.new { |now| (calls += 1) == 1 ? now + 0.01 : Float::NAN }
+    watcher.attach(loop)
+    expect { loop.run }.to raise_error(ArgumentError)
+    watcher.detach
+  end
+end
@@ -0,0 +1,56 @@
+require File.expand_path('../spec_helper', __FILE__)
+
+describe Cool.io::SignalWatcher do
+  let :loop do
+    Cool.io::Loop.new
+  end
+
+  it "calls on_signal when the signal is received" do
+    signals = 0
+    watcher = Cool.io::SignalWatcher.new(:USR1)
+    watcher.on_signal { signals += 1; watcher.detach }
+    watcher.attach(loop)
+
+    Process.kill(:USR1, Process.pid)
+    loop.run
+
+    expect(signals).to eq(1)
+  end
+
+  it "accepts signal names and numbers" do
+    expect(Cool.io::SignalWatcher.new('SIGUSR2').signum).to eq(Signal.list['USR2'])
+    expect(Cool.io::SignalWatcher.new(Signal.list['HUP']).signum).to eq(Signal.list['HUP'])
+    expect { Cool.io::SignalWatcher.new(:NOSUCHSIGNAL) }.to raise_error(ArgumentError)
+    expect { Cool.io::SignalWatcher.new(:SEGV) }.to raise_error(ArgumentError)
+  end
+
+  it "restores the previous handler once detached" do
+    trapped = false
+    previous = Signal.trap(:USR2) { trapped = true }
+
+    begin
+      watcher = Cool.io::SignalWatcher.new(:USR2)
+      watcher.attach(loop)
+      watcher.detach
+
+      Process.kill(:USR2, Process.pid)
+      sleep 0.05
+      expect(trapped).to eq(true)
+    ensure
+      Signal.trap(:USR2, previous)
+    end
+  end
+
+  it "refuses signals already watched by another loop" do
+    watcher = Cool.io::SignalWatcher.new(:USR2)
+    watcher.attach(loop)
+
+    begin
+      expect {
+        Cool.io::SignalWatcher.new(:USR2).attach(Cool.io::Loop.new)
+      }.to raise_error(RuntimeError)
+    ensure
+      watcher.detach
+    end
+  end
+end
@@ -221,5 +221,88 @@ describe Coolio::TCPServer do
         end
       end
     end
+
+    context "#accept_budget" do
+      it "accepts every pending connection in one iteration" do
+        begin
+          connected = 0
+          server = Cool.io::TCPServer.new("127.0.0.1", port, ServerOnConnect, proc { connected += 1 })
+          loop.attach server
+          clients = 10.times.map { TCPSocket.open("127.0.0.1", port) }
+          loop.run_once
+          expect(connected).to eq 10
+        ensure
+          clients.each(&:close) if clients
+          server.detach
+        end
+      end
+
+      it "accepts at most accept_budget connections per iteration" do
+        begin
+          connected = 0
+          server = Cool.io::TCPServer.new("127.0.0.1", port, ServerOnConnect, proc { connected += 1 })
+          server.accept_budget = 4
+          loop.attach server
+          clients = 10.times.map { TCPSocket.open("127.0.0.1", port) }
+          loop.run_once
+          expect(connected).to eq 4
+          loop.run_once
+          expect(connected).to eq 8
+        ensure
+          clients.each(&:close) if clients
+          server.detach
+        end
+      end
+
+      it "closes the rest of the batch when on_connection raises" do
+        begin
+          connected = 0
+          server = Cool.io::TCPServer.new("127.0.0.1", port, ServerOnConnect, proc { connected += 1; raise "boom" })
+          loop.attach server
+          clients = 4.times.map { TCPSocket.open("127.0.0.1", port) }
+          expect { loop.run_once }.to raise_error(RuntimeError, "boom")
+          expect(connected).to eq 1
+
+          closed = clients.count { |c| IO.select([c], nil, nil, 1) and c.read_nonblock(1, exception: false).nil? }
+          expect(closed).to eq 3
+        ensure
+          clients.each(&:close) if clients
+          server.detach
+        end
+      end
+
+      it "closes the batch when wrapping an accepted socket fails" do
+        begin
+          wrapped = 0
+          failing = Class.new(::TCPSocket)
+          failing.define_singleton_method(:for_fd) do |fd|
+            raise "boom" if (wrapped += 1) == 2
+            super(fd)
+          end
+
+          server = Cool.io::TCPServer.new("127.0.0.1", port, ServerOnConnect, proc {})
+          clients = 2.times.map { TCPSocket.open("127.0.0.1", port) }
+          sleep 0.05
+          expect { server.__send__(:accept_batch, 10, failing) }.to raise_error(RuntimeError, "boom")
+
+          closed = clients.count { |c| IO.select([c], nil, nil, 1) and c.read_nonblock(1, exception: false).nil? }
+          expect(closed).to eq 2
+        ensure
+          clients.each(&:close) if clients
+          server.close
+        end
+      end
+
+      it "must be at least 1" do
+        begin
+          server = Cool.io::TCPServer.new("127.0.0.1", port, ServerOnConnect, proc {})
+          expect { server.accept_budget = 0 }.to raise_error(ArgumentError)
+          expect { server.accept_budget = -1 }.to raise_error(ArgumentError)
+          expect(server.accept_budget).to eq Cool.io::Listener::DEFAULT_ACCEPT_BUDGET
+        ensure
+          server.close
+        end
+      end
+    end
   end
 end
@@ -182,4 +182,164 @@ describe Coolio::TCPSocket do
       expect { loop.run }.to raise_error(WriteComplete)
     end
   end
+
+  context "#direct_write" do
+    class DirectWrite < Cool.io::TCPSocket
+      attr :read_data, :completed
+      def on_connect
+        self.direct_write = true
+        @read_data = ""
+        @completed = 0
+      end
+      def on_read(data)
+        @read_data += data
+        close if @read_data.size >= 3
+      end
+      def on_write_complete
+        @completed += 1
+      end
+    end
+
+    it "writes without waiting for the loop" do
+      c = DirectWrite.connect(@host, @port)
+      loop.attach c
+      loop.run_once # on_connect
+      c.write "aaa"
+      expect(c.completed).to eq 1
+      loop.run
+      expect(c.read_data).to eq "aaa"
+    end
+  end
+
+  context "#reuse_read_buffer" do
+    class ReusedReadBuffer < Cool.io::TCPSocket
+      attr :read_data, :buffers
+      def on_connect
+        @read_data = ""
+        @buffers = []
+        write "aaa"
+      end
+      def on_read(data)
+        @read_data += data
+        @buffers << data.object_id
+        close if @read_data.size >= 3
+      end
+    end
+
+    it "passes the same String to each on_read" do
+      c = ReusedReadBuffer.connect(@host, @port)
+      c.reuse_read_buffer = true
+      loop.attach c
+      loop.run
+      expect(c.read_data).to eq "aaa"
+      expect(c.buffers.uniq.size).to eq 1
+    end
+
+    it "can be enabled before the socket is connected" do
+      c = ReusedReadBuffer.allocate
+      c.reuse_read_buffer = true
+      expect(c.reuse_read_buffer?).to eq true
+
+      # As done once DNS resolution completes
+      c.__send__(:initialize, ::TCPSocket.new(@host, @port))
+      c.__send__(:on_connect)
+      loop.attach c
+      loop.run
+      expect(c.read_data).to eq "aaa"
+      expect(c.buffers.uniq.size).to eq 1
+    end
+
+    it "shares the loop's String with :reuse_read_buffer" do
+      shared_loop = Coolio::Loop.new(:reuse_read_buffer => true)
+      c = ReusedReadBuffer.connect(@host, @port)
+      shared_loop.attach c
+      shared_loop.run
+      expect(c.read_data).to eq "aaa"
+      expect(c.buffers.uniq).to eq [shared_loop.read_buffer.object_id]
+    end
+  end
+
+  context "#inactivity_timeout" do
+    class Inactive < Cool.io::TCPSocket
+      attr :timed_out_at, :read_data
+      def on_connect
+        @read_data = ""
+        self.inactivity_timeout = 0.05
+      end
+      def on_read(data)
+        @read_data += data
+      end
+      def on_inactivity_timeout
+        @timed_out_at = Time.now
+        close
+      end
+    end
+
+    it "calls on_inactivity_timeout on idle connections" do
+      c = Inactive.connect(@host, @port)
+      loop.attach c
+      loop.run_once # on_connect
+      started = Time.now
+      loop.run
+      expect(c.timed_out_at - started).to be >= 0.05
+    end
+
+    it "is pushed back by reads" do
+      c = Inactive.connect(@host, @port)
+      loop.attach c
+      loop.run_once # on_connect
+
+      writes = 0
+      writer = Cool.io::TimerWatcher.new(0.02, true)
+      writer.on_timer do
+        c.write "a"
+        writer.detach if (writes += 1) == 5
+      end
+      writer.attach(loop)
+      loop.run
+
+      expect(c.read_data).to eq "aaaaa"
+      expect(c.inactivity_timeout).to eq 0.05
+    end
+
+    it "is pushed back by direct writes" do
+      server = ::TCPServer.new("127.0.0.1", 0)
+      c = Inactive.new(::TCPSocket.new("127.0.0.1", server.addr[1]))
+      peer = server.accept
+      c.direct_write = true
+      c.inactivity_timeout = 0.05
+      loop.attach c
+
+      writes = 0
+      writer = Cool.io::TimerWatcher.new(0.02, true)
+      writer.on_timer do
+        c.write "a"
+        writer.detach if (writes += 1) == 5
+      end
+      writer.attach(loop)
+
+      started = Time.now
+      loop.run
+      expect(peer.read(5)).to eq "aaaaa"
+      expect(c.timed_out_at - started).to be >= 0.13
+    ensure
+      peer.close if peer
+      server.close if server
+    end
+
+    it "can be set before the socket is connected" do
+      c = Inactive.allocate
+      c.inactivity_timeout = 0.05
+      expect(c.inactivity_timeout).to eq 0.05
+
+      # As done once DNS resolution completes
+      c.__send__(:initialize, ::TCPSocket.new(@host, @port))
+      expect(c.inactivity_timeout).to eq 0.05
+
+      loop.attach c
+      started = Time.now
+      loop.run
+      expect(c.timed_out_at - started).to be >= 0.05
+    end
+  end
 end
@@ -0,0 +1,151 @@
+require File.expand_path('../spec_helper', __FILE__)
+
+describe Cool.io::TimerWheel do
+  let :loop do
+    Cool.io::Loop.new
+  end
+
+  let :wheel do
+    Cool.io::TimerWheel.new(0.01, 8).attach(loop)
+  end
+
+  def run_until(timeout)
+    deadline = Time.now + timeout
+    loop.run_once(0.01) until yield || Time.now > deadline
+  end
+
+  it "calls on_timeout for each object once its timeout has passed" do
+    expired = []
+    wheel.on_timeout { |object| expired << [object, Time.now] }
+
+    started = Time.now
+    wheel.add(:a, 0.02)
+    wheel.add(:b, 0.05)
+    expect(wheel.size).to eq(2)
+
+    run_until(1) { expired.size == 2 }
+
+    expect(expired.map(&:first)).to eq([:a, :b])
+    expect(expired[0][1] - started).to be >= 0.02
+    expect(expired[1][1] - started).to be >= 0.05
+    expect(wheel.size).to eq(0)
+  end
+
+  it "handles timeouts longer than a turn of the wheel" do
+    expired = []
+    wheel.on_timeout { |object| expired << object }
+
+    started = Time.now
+    wheel.add(:later, 0.15)
+    run_until(1) { expired.any? }
+
+    expect(expired).to eq([:later])
+    expect(Time.now - started).to be >= 0.15
+  end
+
+  it "replaces the timeout of objects added again" do
+    expired = []
+    wheel.on_timeout { |object| expired << object }
+
+    wheel.add(:a, 0.02)
+    wheel.add(:a, 0.2)
+    expect(wheel.size).to eq(1)
+
+    run_until(0.1) { expired.any? }
+    expect(expired).to eq([])
+    expect(wheel.include?(:a)).to eq(true)
+  end
+
+  it "cancels removed timeouts" do
+    expired = []
+    wheel.on_timeout { |object| expired << object }
+
+    wheel.add(:a, 0.02)
+    wheel.add(:b, 0.02)
+    expect(wheel.remove(:a)).to eq(true)
+    expect(wheel.remove(:a)).to eq(false)
+
+    run_until(1) { expired.any? }
+    expect(expired).to eq([:b])
+  end
+
+  it "never fires timeouts early, however often it's woken up" do
+    early = []
+    deadlines = {}
+    wheel.on_timeout do |object|
+      now = Process.clock_gettime(Process::CLOCK_MONOTONIC)
+      early << object if now < deadlines[object]
+      deadlines.delete(object)
+    end
+
+    20.times do |i|
+      timeout = 0.005 * (i + 1)
+      deadlines[i] = Process.clock_gettime(Process::CLOCK_MONOTONIC) + timeout
+      wheel.add(i, timeout)
+      loop.run_once(0)
+    end
+
+    run_until(1) { deadlines.empty? }
+    expect(early).to eq([])
+    expect(deadlines).to eq({})
+  end
+
+  it "only takes finite timeouts" do
+    expect { wheel.add(:a, Float::INFINITY) }.to raise_error(ArgumentError)
+    expect { wheel.add(:a, Float::NAN) }.to raise_error(ArgumentError)
+    expect(wheel.size).to eq(0)
+
+    wheel.add(:a, 1e300)
+    expect(wheel.include?(:a)).to eq(true)
+    run_until(0.05) { false }
+    expect(wheel.include?(:a)).to eq(true)
+  end
+
+  it "still times out the rest of a batch after an on_timeout raises" do
+    expired = []
+    wheel.on_timeout do |object|
+      expired << object
+      raise "boom" if object == :a
+    end
+
+    wheel.add(:a, 0.02)
+    wheel.add(:b, 0.02)
+    wheel.add(:c, 0.02)
+    sleep 0.05
+
+    expect { loop.run_once(0.1) }.to raise_error(RuntimeError, "boom")
+    expect(expired).to eq([:a])
+    expect(wheel.include?(:a)).to eq(false)
+    expect(wheel.size).to eq(2)
+
+    run_until(1) { expired.size == 3 }
+    expect(expired).to eq([:a, :b, :c])
+    expect(wheel.size).to eq(0)
+  end
+
+  it "skips objects removed by an earlier on_timeout in the same batch" do
+    expired = []
+    removed = nil
+    wheel.on_timeout do |object|
+      expired << object
+      removed = wheel.remove(:b) if object == :a
+    end
+
+    wheel.add(:a, 0.02)
+    wheel.add(:b, 0.02)
+    sleep 0.05
+
+    run_until(1) { expired.any? }
+    loop.run_once(0.05)
+    expect(expired).to eq([:a])
+    expect(removed).to eq(true)
+    expect(wheel.size).to eq(0)
+  end
+
+  it "stops ticking once nothing is pending" do
+    wheel.add(:a, 0.01)
+    run_until(1) { wheel.size == 0 }
+
+    expect(loop.run_once(0.05)).to eq(0)
+  end
+end
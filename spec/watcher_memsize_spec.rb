@@ -0,0 +1,18 @@
+require File.expand_path('../spec_helper', __FILE__)
+require 'objspace'
+
+describe Cool.io::Watcher do
+  it "sizes each watcher type for its own libev watcher" do
+    reader, writer = ::IO.pipe
+
+    io_size    = ObjectSpace.memsize_of(Cool.io::IOWatcher.new(reader))
+    timer_size = ObjectSpace.memsize_of(Cool.io::TimerWatcher.new(1))
+    stat_size  = ObjectSpace.memsize_of(Cool.io::StatWatcher.new(__FILE__))
+
+    expect(io_size).to be < stat_size
+    expect(timer_size).to be < stat_size
+
+    reader.close
+    writer.close
+  end
+end